@@ -7,8 +7,34 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
+// shadow filtering tiers, one shader variant each; SHADOW_QUALITY is defined by the
+// application (ShadowQuality in ShadowCache.h). PARABOLOID replaces the cube map with the
+// dual-paraboloid map and ignores the tier
+#define SHADOW_OFF 0   // no shadow map lookups at all
+#define SHADOW_HARD 1  // one hardware compare tap
+#define SHADOW_PCF4 2  // 4 compare taps, the other 16 only where they disagree
+#define SHADOW_PCF20 3 // 20 taps with manual compares
+#define SHADOW_ESM 4   // one linear fetch of the blurred exponential shadow map
+#ifndef SHADOW_QUALITY
+#define SHADOW_QUALITY SHADOW_PCF20
+#endif
+
+#ifdef INSTANCED_BALLS
+flat in float Layer;
+uniform sampler2DArray diffuseTextures;
+#else
 uniform sampler2D diffuseTexture;
-uniform samplerCube depthMap;
+#endif
+#if defined(PARABOLOID)
+uniform sampler2DArrayShadow depthMap; // the two hemispheres of ParaboloidShadow
+#elif SHADOW_QUALITY == SHADOW_HARD || SHADOW_QUALITY == SHADOW_PCF4
+uniform samplerCubeShadow depthMap; // bound with a GL_COMPARE_REF_TO_TEXTURE sampler
+#else
+uniform samplerCube depthMap; // the ESM cube map for SHADOW_ESM
+#endif
+#if SHADOW_QUALITY == SHADOW_ESM && !defined(PARABOLOID)
+uniform float esmExponent;
+#endif
 
 uniform vec3 lightPos;
 uniform vec3 viewPos;
@@ -17,16 +43,74 @@ uniform float far_plane;
 uniform bool shadows;
 
 
-// array of offset direction for sampling
+// array of offset direction for sampling; the first four form a tetrahedron, the taps of SHADOW_PCF4
 vec3 gridSamplingDisk[20] = vec3[]
 (
-   vec3(1, 1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1, 1,  1), 
-   vec3(1, 1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
+   vec3(1, 1,  1), vec3( 1, -1, -1), vec3(-1, -1,  1), vec3(-1, 1, -1),
+   vec3(1, 1, -1), vec3( 1, -1,  1), vec3(-1, -1, -1), vec3(-1, 1,  1),
    vec3(1, 1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1, 1,  0),
    vec3(1, 0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1, 0, -1),
    vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
 );
 
+#if defined(PARABOLOID)
+// dual-paraboloid map, one hardware compare tap: the hemisphere the direction falls in and
+// the same warp as the depth pass
+float ShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - lightPos;
+    float distance = length(fragToLight);
+    vec3 direction = fragToLight / distance;
+    float layer = direction.y < 0.0 ? 0.0 : 1.0;
+    vec2 uv = vec2(direction.x, direction.z) / (1.0 + abs(direction.y)) * 0.5 + 0.5;
+    float bias = 0.15;
+    return 1.0 - texture(depthMap, vec4(uv, layer, (distance - bias) / far_plane));
+}
+#elif SHADOW_QUALITY == SHADOW_OFF
+float ShadowCalculation(vec3 fragPos)
+{
+    return 0.0;
+}
+#elif SHADOW_QUALITY == SHADOW_HARD
+float ShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - lightPos;
+    float bias = 0.15;
+    // 1.0 where the biased depth is in front of the stored one; the linear filter of the
+    // compare sampler blends the results of the 2x2 texels around the direction
+    float lit = texture(depthMap, vec4(fragToLight, (length(fragToLight) - bias) / far_plane));
+    return 1.0 - lit;
+}
+#elif SHADOW_QUALITY == SHADOW_PCF4
+float ShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - lightPos;
+    float bias = 0.15;
+    float reference = (length(fragToLight) - bias) / far_plane;
+    float viewDistance = length(viewPos - fragPos);
+    float diskRadius = (1.0 + (viewDistance / far_plane)) / 25.0;
+    float lit = 0.0;
+    for(int i = 0; i < 4; ++i)
+        lit += texture(depthMap, vec4(fragToLight + gridSamplingDisk[i] * diskRadius, reference));
+    // fully lit or fully in shadow: the remaining taps would agree, stop here
+    if(lit == 0.0 || lit == 4.0)
+        return 1.0 - lit / 4.0;
+    // penumbra: all 20 taps
+    for(int i = 4; i < 20; ++i)
+        lit += texture(depthMap, vec4(fragToLight + gridSamplingDisk[i] * diskRadius, reference));
+    return 1.0 - lit / 20.0;
+}
+#elif SHADOW_QUALITY == SHADOW_ESM
+float ShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - lightPos;
+    float bias = 0.05;
+    float receiver = (length(fragToLight) - bias) / far_plane;
+    // blurred exp(c * occluder); exp(c * (occluder - receiver)) is the visibility, 1 or more where lit
+    float occluders = texture(depthMap, fragToLight).r;
+    return 1.0 - clamp(occluders * exp(-esmExponent * receiver), 0.0, 1.0);
+}
+#else
 float ShadowCalculation(vec3 fragPos)
 {
     // get vector between fragment position and light position
@@ -78,10 +162,15 @@ float ShadowCalculation(vec3 fragPos)
         
     return shadow;
 }
+#endif
 
 void main()
 {           
+#ifdef INSTANCED_BALLS
+    vec3 color = texture(diffuseTextures, vec3(fs_in.TexCoords, Layer)).rgb;
+#else
     vec3 color = texture(diffuseTexture, fs_in.TexCoords).rgb;
+#endif
     vec3 normal = normalize(fs_in.Normal);
     vec3 lightColor = vec3(0.7);
     // ambient
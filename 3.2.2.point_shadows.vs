@@ -2,6 +2,11 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef INSTANCED_BALLS
+layout (location = 3) in vec4 aInstance; // xyz: ball center, w: radius
+layout (location = 4) in float aLayer;   // texture array layer of the ball's appearance
+flat out float Layer;
+#endif
 
 out vec2 TexCoords;
 
@@ -20,6 +25,14 @@ uniform bool reverse_normals;
 
 void main()
 {
+#ifdef INSTANCED_BALLS
+    // unit sphere scaled by the radius and moved to the center; uniform scale keeps the normal
+    vs_out.FragPos = aInstance.xyz + aPos * aInstance.w;
+    vs_out.Normal = aNormal;
+    vs_out.TexCoords = aTexCoords;
+    Layer = aLayer;
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+#else
     vs_out.FragPos = vec3(model * vec4(aPos + displacement, 1.0));
     if(reverse_normals) // a slight hack to make sure the outer large cube displays lighting from the 'inside' instead of the default 'outside'.
         vs_out.Normal = transpose(inverse(mat3(model))) * (-1.0 * aNormal);
@@ -27,4 +40,5 @@ void main()
         vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
     vs_out.TexCoords = aTexCoords;
     gl_Position = projection * view * model * vec4(aPos + displacement, 1.0);
+#endif
 }
\ No newline at end of file
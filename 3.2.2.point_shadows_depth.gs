@@ -8,7 +8,7 @@ out vec4 FragPos; // FragPos from GS (output per emitvertex)
 
 void main()
 {
-    for(int face = 0; face < 5; ++face)
+    for(int face = 0; face < 6; ++face)
     {
         gl_Layer = face; // built-in variable that specifies to which face we render.
         for(int i = 0; i < 3; ++i) // for each triangle's vertices
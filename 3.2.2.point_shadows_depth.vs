@@ -1,10 +1,52 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED_BALLS
+layout (location = 3) in vec4 aInstance; // xyz: ball center, w: radius
+#endif
 
 uniform mat4 model;
 uniform vec3 displacement;
 
+#ifdef SINGLE_FACE
+// one cube map face per draw, no geometry shader: project here
+uniform mat4 shadowMatrix;
+
+out vec4 FragPos;
+#endif
+
+#ifdef PARABOLOID
+// one paraboloid hemisphere per draw (ParaboloidShadow)
+uniform vec3 lightPos;
+uniform float far_plane;
+uniform float hemisphere; // -1 looks down, 1 up
+
+out vec4 FragPos;
+
+// the hemispheres overlap a little, so filtering at the seam finds depth on both sides
+#define PARABOLOID_OVERLAP 0.05
+#endif
+
 void main()
 {
-    gl_Position = model * vec4(aPos + displacement, 1.0);
+#ifdef INSTANCED_BALLS
+    vec4 worldPos = vec4(aInstance.xyz + aPos * aInstance.w, 1.0);
+#else
+    vec4 worldPos = model * vec4(aPos + displacement, 1.0);
+#endif
+#if defined(SINGLE_FACE)
+    FragPos = worldPos;
+    gl_Position = shadowMatrix * worldPos;
+#elif defined(PARABOLOID)
+    FragPos = worldPos;
+    vec3 toVertex = worldPos.xyz - lightPos;
+    float distance = length(toVertex);
+    vec3 direction = toVertex / distance;
+    // cosine to the hemisphere axis; vertices behind the hemisphere are clipped, and the
+    // divisor is kept away from 0 so clipping interpolates finite positions
+    float z = hemisphere * direction.y;
+    gl_ClipDistance[0] = z + PARABOLOID_OVERLAP;
+    gl_Position = vec4(vec2(direction.x, direction.z) / max(1.0 + z, PARABOLOID_OVERLAP), distance / far_plane * 2.0 - 1.0, 1.0);
+#else
+    gl_Position = worldPos; // the geometry shader projects into every face
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <xmmintrin.h>
+
+// std::vector allocator returning ALIGNMENT-byte aligned storage, so the SIMD kernels can
+// use aligned loads from the start of every array
+template <typename T, size_t ALIGNMENT = 32>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, ALIGNMENT> other;
+    };
+
+    AlignedAllocator() {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) {}
+
+    T* allocate(size_t n) {
+        void* p = _mm_malloc(n * sizeof(T), ALIGNMENT);
+        if (!p)
+            throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) {
+        _mm_free(p);
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, ALIGNMENT>&) const { return false; }
+};
+
+#endif // ALIGNED_ALLOCATOR_H
@@ -0,0 +1,108 @@
+#include "BallGrid.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+BallGrid::BallGrid(float roomWidth, float roomHeight, float roomDepth)
+    : roomMin(-roomWidth / 2.0f, -roomHeight / 2.0f, -roomDepth / 2.0f),
+      roomSize(roomWidth, roomHeight, roomDepth), cellSize(1.0f) {
+    dims[0] = dims[1] = dims[2] = 1;
+}
+
+// balls slightly outside the room (before the wall response) go to the border cells
+int BallGrid::cellCoord(float p, int axis) const {
+    int c = (int)std::floor((p - roomMin[axis]) / cellSize);
+    return std::min(std::max(c, 0), dims[axis] - 1);
+}
+
+void BallGrid::build(const BallSystem& balls) {
+    PROFILE_SCOPE("BallGrid::build");
+    size_t count = balls.size();
+
+    float maxRadius = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+        maxRadius = std::max(maxRadius, balls.radius[i]);
+    // one diameter per cell, or coarser if the room would need too many cells
+    float largestSide = std::max(roomSize.x, std::max(roomSize.y, roomSize.z));
+    cellSize = std::max(2.0f * maxRadius, largestSide / MAX_CELLS_PER_AXIS);
+    if (cellSize <= 0.0f)
+        cellSize = 1.0f;
+    for (int axis = 0; axis < 3; ++axis)
+        dims[axis] = std::max(1, (int)std::ceil(roomSize[axis] / cellSize));
+
+    // counting sort of the balls by cell
+    int cells = cellCount();
+    cellStart.assign(cells + 1, 0);
+    ballCell.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        int cx = cellCoord(balls.posX[i], 0);
+        int cy = cellCoord(balls.posY[i], 1);
+        int cz = cellCoord(balls.posZ[i], 2);
+        uint32_t cell = (uint32_t)((cz * dims[1] + cy) * dims[0] + cx);
+        ballCell[i] = cell;
+        cellStart[cell + 1]++;
+    }
+    for (int c = 0; c < cells; ++c)
+        cellStart[c + 1] += cellStart[c];
+
+    sorted.resize(count);
+    std::vector<uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+        sorted[next[ballCell[i]]++] = (uint32_t)i;
+}
+
+int BallGrid::collide(BallSystem& balls, float restitution, float mass) {
+    PROFILE_SCOPE("BallGrid::collide");
+    int contacts = 0;
+    // walk the balls cell by cell so neighbouring cells stay in cache
+    for (size_t k = 0; k < sorted.size(); ++k) {
+        uint32_t i = sorted[k];
+        uint32_t cell = ballCell[i];
+        int cx = cell % dims[0];
+        int cy = (cell / dims[0]) % dims[1];
+        int cz = cell / (dims[0] * dims[1]);
+
+        for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, dims[2] - 1); ++z) {
+            for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, dims[1] - 1); ++y) {
+                for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, dims[0] - 1); ++x) {
+                    int neighbour = (z * dims[1] + y) * dims[0] + x;
+                    for (uint32_t n = cellStart[neighbour]; n < cellStart[neighbour + 1]; ++n) {
+                        uint32_t j = sorted[n];
+                        // every pair once; two resting balls stay at rest
+                        if (j <= i || (!balls.active[i] && !balls.active[j]))
+                            continue;
+
+                        glm::vec3 delta = balls.getPosition(j) - balls.getPosition(i);
+                        float minDistance = balls.radius[i] + balls.radius[j];
+                        float distance2 = glm::dot(delta, delta);
+                        if (distance2 >= minDistance * minDistance || distance2 <= 0.0f)
+                            continue;
+
+                        float distance = std::sqrt(distance2);
+                        glm::vec3 normal = delta / distance;
+                        contacts++;
+
+                        // separate the overlap evenly so the pair does not stick together
+                        glm::vec3 correction = normal * (0.5f * (minDistance - distance));
+                        balls.posX[i] -= correction.x; balls.posY[i] -= correction.y; balls.posZ[i] -= correction.z;
+                        balls.posX[j] += correction.x; balls.posY[j] += correction.y; balls.posZ[j] += correction.z;
+                        balls.setActive(i, true);
+                        balls.setActive(j, true);
+
+                        // impulse along the normal, only while the balls approach each other
+                        glm::vec3 vi = balls.getVelocity(i);
+                        glm::vec3 vj = balls.getVelocity(j);
+                        float approach = glm::dot(vi - vj, normal);
+                        if (approach <= 0.0f)
+                            continue;
+                        float impulse = (1.0f + restitution) * approach / (2.0f / mass);
+                        balls.setVelocity(i, vi - normal * (impulse / mass));
+                        balls.setVelocity(j, vj + normal * (impulse / mass));
+                    }
+                }
+            }
+        }
+    }
+    return contacts;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef BALL_GRID_H
+#define BALL_GRID_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "BallSystem.h"
+
+// Uniform-grid broad phase for ball-ball collisions. The grid covers the room (centered at
+// the origin) and is rebuilt every step with a counting sort, so building it and finding
+// all contacts are both linear in the number of balls as long as the ball density stays
+// bounded. Cells are at least one ball diameter wide, so every contact of a ball lies in
+// its own cell or one of the 26 neighbours.
+class BallGrid {
+public:
+    static const int MAX_CELLS_PER_AXIS = 128;
+
+    BallGrid(float roomWidth, float roomHeight, float roomDepth);
+
+    // sorts the balls into cells; the cell size follows the largest radius
+    void build(const BallSystem& balls);
+
+    // elastic sphere-sphere response for every overlapping pair found in the grid;
+    // restitution and mass are those used for all other ball collisions. Returns the contacts.
+    int collide(BallSystem& balls, float restitution, float mass);
+
+    int cellCount() const {
+        return dims[0] * dims[1] * dims[2];
+    }
+
+private:
+    glm::vec3 roomMin;
+    glm::vec3 roomSize;
+    float cellSize;
+    int dims[3];
+    std::vector<uint32_t> cellStart; // balls of cell c are sorted[cellStart[c] .. cellStart[c + 1])
+    std::vector<uint32_t> sorted;    // ball indices ordered by cell
+    std::vector<uint32_t> ballCell;  // cell of every ball
+
+    int cellCoord(float p, int axis) const;
+};
+
+#endif // BALL_GRID_H
@@ -0,0 +1,257 @@
+#pragma once
+#ifndef BALL_RENDERER_H
+#define BALL_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "Ball.h"
+#include "BallSystem.h"
+#include "CpuProfiler.h"
+#include "Shader.h"
+#include "ShadowCulling.h"
+
+// Per-ball data streamed to the GPU every frame
+struct BallInstance {
+    glm::vec3 center;
+    float radius;
+    float layer; // layer of the appearance in the texture array
+};
+
+// Draws every ball with a single instanced call per pass. All balls share Ball::unitSphere();
+// center, radius and appearance come from a per-instance buffer, and the appearance textures
+// (room walls, tumbler, the white start texture) are copied into one GL_TEXTURE_2D_ARRAY so
+// that a ball can change its look without changing any GL binding.
+// Use with shaders compiled with INSTANCED_BALLS defined.
+class BallRenderer {
+public:
+    static const int LAYER_SIZE = 512;
+    static const int MAX_LAYERS = 16;
+
+    BallRenderer() : VAO(0), instanceVBO(0), instanceCapacity(0), depthVAO(0), depthVBO(0), depthCapacity(0),
+        textureArray(0), layerCount(0) {}
+
+    // needs a current GL context
+    void init() {
+        const SphereMesh& sphere = Ball::unitSphere();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &instanceVBO);
+        glBindVertexArray(VAO);
+        // unit sphere: the same vertex layout Ball::unitSphere() uses
+        glBindBuffer(GL_ARRAY_BUFFER, sphere.VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere.EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        // per-instance center/radius and layer
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(BallInstance), (void*)offsetof(BallInstance, center));
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(BallInstance), (void*)offsetof(BallInstance, layer));
+        glVertexAttribDivisor(4, 1);
+        glBindVertexArray(0);
+
+        // per-face culled instances for the shadow pass, position and center/radius only
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &depthVBO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, sphere.VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere.EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glVertexAttribDivisor(3, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glGenTextures(1, &textureArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, LAYER_SIZE, LAYER_SIZE, MAX_LAYERS, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(2, copyFBO);
+    }
+
+    // packs the balls of this frame into the instance buffer; both passes draw from it
+    void update(const BallSystem& balls, float alpha) {
+        PROFILE_SCOPE("BallRenderer::update");
+        instances.resize(balls.size());
+        boundsMin = glm::vec3(INFINITY);
+        boundsMax = glm::vec3(-INFINITY);
+        for (size_t i = 0; i < balls.size(); ++i) {
+            instances[i].center = balls.getRenderPosition(i, alpha);
+            instances[i].radius = balls.radius[i];
+            instances[i].layer = (float)layerFor(balls.texture[i]);
+            boundsMin = glm::min(boundsMin, instances[i].center - glm::vec3(instances[i].radius));
+            boundsMax = glm::max(boundsMax, instances[i].center + glm::vec3(instances[i].radius));
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (instances.size() > instanceCapacity) {
+            instanceCapacity = instances.size() * 2;
+        }
+        // orphan last frame's storage so the upload never waits for the GPU to finish with it
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(BallInstance), NULL, GL_STREAM_DRAW);
+        if (!instances.empty())
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(BallInstance), &instances[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // world space box around all balls of this frame, empty (min > max) without balls
+    const glm::vec3& getBoundsMin() const {
+        return boundsMin;
+    }
+
+    const glm::vec3& getBoundsMax() const {
+        return boundsMax;
+    }
+
+    // draws all balls with the currently bound INSTANCED_BALLS shader
+    void draw(Shader& shader) {
+        if (instances.empty())
+            return;
+        shader.setInt("diffuseTextures", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, Ball::unitSphere().indexCount, GL_UNSIGNED_INT, 0, (GLsizei)instances.size());
+        glBindVertexArray(0);
+    }
+
+    // draws all balls into the shadow cube map; no textures needed
+    void drawDepth() {
+        if (instances.empty())
+            return;
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, Ball::unitSphere().indexCount, GL_UNSIGNED_INT, 0, (GLsizei)instances.size());
+        glBindVertexArray(0);
+    }
+
+    // sorts the balls of this frame by the cube map faces they touch, after update(); a ball
+    // seen by several faces is listed once per face
+    void cullDepth(const CubeFaceCuller& culler) {
+        PROFILE_SCOPE("BallRenderer::cullDepth");
+        faceMasks.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); ++i)
+            faceMasks[i] = culler.sphereFaces(instances[i].center, instances[i].radius);
+
+        faceInstances.clear();
+        for (int face = 0; face < 6; ++face) {
+            faceFirst[face] = (GLuint)faceInstances.size();
+            for (size_t i = 0; i < instances.size(); ++i) {
+                if (faceMasks[i] & (1u << face))
+                    faceInstances.push_back(glm::vec4(instances[i].center, instances[i].radius));
+            }
+            faceCount[face] = (GLsizei)(faceInstances.size() - faceFirst[face]);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+        if (faceInstances.size() > depthCapacity) {
+            depthCapacity = faceInstances.size() * 2;
+        }
+        glBufferData(GL_ARRAY_BUFFER, depthCapacity * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+        if (!faceInstances.empty())
+            glBufferSubData(GL_ARRAY_BUFFER, 0, faceInstances.size() * sizeof(glm::vec4), &faceInstances[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // faces with at least one ball after cullDepth
+    unsigned int depthFaces() const {
+        unsigned int mask = 0;
+        for (int face = 0; face < 6; ++face) {
+            if (faceCount[face] > 0)
+                mask |= 1u << face;
+        }
+        return mask;
+    }
+
+    // draws the balls cullDepth listed for one face, with a SINGLE_FACE depth shader
+    void drawDepthFace(int face) {
+        if (faceCount[face] == 0)
+            return;
+        glBindVertexArray(depthVAO);
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, Ball::unitSphere().indexCount, GL_UNSIGNED_INT, 0, faceCount[face], faceFirst[face]);
+        glBindVertexArray(0);
+    }
+
+private:
+    unsigned int VAO;
+    unsigned int instanceVBO;
+    size_t instanceCapacity;
+    unsigned int depthVAO;
+    unsigned int depthVBO;
+    size_t depthCapacity;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    std::vector<unsigned int> faceMasks;
+    std::vector<glm::vec4> faceInstances; // center, radius; grouped by face
+    GLuint faceFirst[6] = { 0, 0, 0, 0, 0, 0 };
+    GLsizei faceCount[6] = { 0, 0, 0, 0, 0, 0 };
+    unsigned int textureArray;
+    unsigned int copyFBO[2];
+    int layerCount;
+    std::map<unsigned int, int> layers; // 2D texture id -> layer in textureArray
+    std::vector<BallInstance> instances;
+
+    // layer holding the given 2D texture; copied (and rescaled) into the array on first use
+    int layerFor(unsigned int texture) {
+        auto it = layers.find(texture);
+        if (it != layers.end())
+            return it->second;
+        if (layerCount >= MAX_LAYERS) {
+            std::cout << "BallRenderer: texture array is full, texture " << texture << " uses layer 0" << std::endl;
+            layers[texture] = 0;
+            return 0;
+        }
+
+        int width = 0, height = 0;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        int layer = layerCount++;
+        layers[texture] = layer;
+        if (width == 0 || height == 0)
+            return layer;
+
+        // GPU-side copy with a linear rescale to LAYER_SIZE, no need to decode the image again
+        GLint drawFBO = 0, readFBO = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFBO);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFBO);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFBO[0]);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copyFBO[1]);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureArray, 0, layer);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, LAYER_SIZE, LAYER_SIZE, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFBO);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return layer;
+    }
+};
+
+#endif // BALL_RENDERER_H
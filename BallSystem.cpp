@@ -0,0 +1,201 @@
+#include "BallSystem.h"
+#include "Ball.h"
+#include "CpuProfiler.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BALL_SYSTEM_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BALL_SYSTEM_SSE2 1
+#endif
+
+const float BallSystem::GRAVITY = 0.981f;
+const float BallSystem::AIR_RESISTANCE = 0.047f;
+const float BallSystem::FLOOR_Y = -7.0f;
+
+void BallSystem::reserve(size_t count) {
+    posX.reserve(count); posY.reserve(count); posZ.reserve(count);
+    prevX.reserve(count); prevY.reserve(count); prevZ.reserve(count);
+    velX.reserve(count); velY.reserve(count); velZ.reserve(count);
+    radius.reserve(count);
+    active.reserve(count);
+    texture.reserve(count);
+}
+
+void BallSystem::clear() {
+    posX.clear(); posY.clear(); posZ.clear();
+    prevX.clear(); prevY.clear(); prevZ.clear();
+    velX.clear(); velY.clear(); velZ.clear();
+    radius.clear();
+    active.clear();
+    texture.clear();
+}
+
+size_t BallSystem::add(const glm::vec3& position, const glm::vec3& velocity, float rad, unsigned int tex) {
+    posX.push_back(position.x); posY.push_back(position.y); posZ.push_back(position.z);
+    prevX.push_back(position.x); prevY.push_back(position.y); prevZ.push_back(position.z);
+    velX.push_back(velocity.x); velY.push_back(velocity.y); velZ.push_back(velocity.z);
+    radius.push_back(rad);
+    active.push_back(0xFFFFFFFFu);
+    texture.push_back(tex);
+    return posX.size() - 1;
+}
+
+// reference implementation, also handles the tail the vector kernels leave over
+void BallSystem::integrateScalar(size_t begin, size_t end, float deltaTime) {
+    for (size_t i = begin; i < end; ++i) {
+        prevX[i] = posX[i];
+        prevY[i] = posY[i];
+        prevZ[i] = posZ[i];
+        if (!active[i])
+            continue;
+
+        float vx = velX[i];
+        float vy = velY[i] - GRAVITY * deltaTime;
+        float vz = velZ[i];
+
+        // v += -k * |v| * v * dt
+        float speed = std::sqrt(vx * vx + vy * vy + vz * vz);
+        float drag = 1.0f - AIR_RESISTANCE * speed * deltaTime;
+        vx *= drag;
+        vy *= drag;
+        vz *= drag;
+
+        posX[i] += vx * deltaTime;
+        posY[i] += vy * deltaTime;
+        posZ[i] += vz * deltaTime;
+
+        // close to the floor and slow enough: put it on the floor and stop simulating it
+        if (posY[i] - radius[i] <= FLOOR_Y + heightTolerance &&
+            vx * vx + vy * vy + vz * vz < velocityTolerance * velocityTolerance) {
+            active[i] = 0u;
+            posY[i] = FLOOR_Y + radius[i];
+            vx = vy = vz = 0.0f;
+        }
+        velX[i] = vx;
+        velY[i] = vy;
+        velZ[i] = vz;
+    }
+}
+
+void BallSystem::integrate(float deltaTime) {
+    PROFILE_SCOPE("BallSystem::integrate");
+    size_t count = size();
+    size_t i = 0;
+
+#if defined(BALL_SYSTEM_AVX)
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 gravityStep = _mm256_set1_ps(GRAVITY * deltaTime);
+    const __m256 dragStep = _mm256_set1_ps(AIR_RESISTANCE * deltaTime);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 restHeight = _mm256_set1_ps(FLOOR_Y + heightTolerance);
+    const __m256 floorY = _mm256_set1_ps(FLOOR_Y);
+    const __m256 restSpeed2 = _mm256_set1_ps(velocityTolerance * velocityTolerance);
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_load_ps(&posX[i]);
+        __m256 py = _mm256_load_ps(&posY[i]);
+        __m256 pz = _mm256_load_ps(&posZ[i]);
+        _mm256_store_ps(&prevX[i], px);
+        _mm256_store_ps(&prevY[i], py);
+        _mm256_store_ps(&prevZ[i], pz);
+
+        __m256 act = _mm256_castsi256_ps(_mm256_load_si256((const __m256i*)&active[i]));
+        if (_mm256_movemask_ps(act) == 0)
+            continue;
+
+        __m256 vx = _mm256_load_ps(&velX[i]);
+        __m256 vy = _mm256_sub_ps(_mm256_load_ps(&velY[i]), gravityStep);
+        __m256 vz = _mm256_load_ps(&velZ[i]);
+
+        __m256 speed2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+        __m256 drag = _mm256_sub_ps(one, _mm256_mul_ps(dragStep, _mm256_sqrt_ps(speed2)));
+        vx = _mm256_mul_ps(vx, drag);
+        vy = _mm256_mul_ps(vy, drag);
+        vz = _mm256_mul_ps(vz, drag);
+
+        __m256 nx = _mm256_add_ps(px, _mm256_mul_ps(vx, dt));
+        __m256 ny = _mm256_add_ps(py, _mm256_mul_ps(vy, dt));
+        __m256 nz = _mm256_add_ps(pz, _mm256_mul_ps(vz, dt));
+
+        __m256 r = _mm256_load_ps(&radius[i]);
+        speed2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+        __m256 rest = _mm256_and_ps(act, _mm256_and_ps(
+            _mm256_cmp_ps(_mm256_sub_ps(ny, r), restHeight, _CMP_LE_OQ),
+            _mm256_cmp_ps(speed2, restSpeed2, _CMP_LT_OQ)));
+        ny = _mm256_blendv_ps(ny, _mm256_add_ps(floorY, r), rest);
+        vx = _mm256_andnot_ps(rest, vx);
+        vy = _mm256_andnot_ps(rest, vy);
+        vz = _mm256_andnot_ps(rest, vz);
+
+        // resting balls keep their state untouched
+        _mm256_store_ps(&posX[i], _mm256_blendv_ps(px, nx, act));
+        _mm256_store_ps(&posY[i], _mm256_blendv_ps(py, ny, act));
+        _mm256_store_ps(&posZ[i], _mm256_blendv_ps(pz, nz, act));
+        _mm256_store_ps(&velX[i], _mm256_blendv_ps(_mm256_load_ps(&velX[i]), vx, act));
+        _mm256_store_ps(&velY[i], _mm256_blendv_ps(_mm256_load_ps(&velY[i]), vy, act));
+        _mm256_store_ps(&velZ[i], _mm256_blendv_ps(_mm256_load_ps(&velZ[i]), vz, act));
+        _mm256_store_si256((__m256i*)&active[i], _mm256_castps_si256(_mm256_andnot_ps(rest, act)));
+    }
+#elif defined(BALL_SYSTEM_SSE2)
+    // SSE2 has no blendv: select(a, b, mask) = (mask & b) | (~mask & a)
+#define BALL_SELECT(a, b, mask) _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a))
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 gravityStep = _mm_set1_ps(GRAVITY * deltaTime);
+    const __m128 dragStep = _mm_set1_ps(AIR_RESISTANCE * deltaTime);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 restHeight = _mm_set1_ps(FLOOR_Y + heightTolerance);
+    const __m128 floorY = _mm_set1_ps(FLOOR_Y);
+    const __m128 restSpeed2 = _mm_set1_ps(velocityTolerance * velocityTolerance);
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_load_ps(&posX[i]);
+        __m128 py = _mm_load_ps(&posY[i]);
+        __m128 pz = _mm_load_ps(&posZ[i]);
+        _mm_store_ps(&prevX[i], px);
+        _mm_store_ps(&prevY[i], py);
+        _mm_store_ps(&prevZ[i], pz);
+
+        __m128 act = _mm_castsi128_ps(_mm_load_si128((const __m128i*)&active[i]));
+        if (_mm_movemask_ps(act) == 0)
+            continue;
+
+        __m128 vx = _mm_load_ps(&velX[i]);
+        __m128 vy = _mm_sub_ps(_mm_load_ps(&velY[i]), gravityStep);
+        __m128 vz = _mm_load_ps(&velZ[i]);
+
+        __m128 speed2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+        __m128 drag = _mm_sub_ps(one, _mm_mul_ps(dragStep, _mm_sqrt_ps(speed2)));
+        vx = _mm_mul_ps(vx, drag);
+        vy = _mm_mul_ps(vy, drag);
+        vz = _mm_mul_ps(vz, drag);
+
+        __m128 nx = _mm_add_ps(px, _mm_mul_ps(vx, dt));
+        __m128 ny = _mm_add_ps(py, _mm_mul_ps(vy, dt));
+        __m128 nz = _mm_add_ps(pz, _mm_mul_ps(vz, dt));
+
+        __m128 r = _mm_load_ps(&radius[i]);
+        speed2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+        __m128 rest = _mm_and_ps(act, _mm_and_ps(
+            _mm_cmple_ps(_mm_sub_ps(ny, r), restHeight),
+            _mm_cmplt_ps(speed2, restSpeed2)));
+        ny = BALL_SELECT(ny, _mm_add_ps(floorY, r), rest);
+        vx = _mm_andnot_ps(rest, vx);
+        vy = _mm_andnot_ps(rest, vy);
+        vz = _mm_andnot_ps(rest, vz);
+
+        // resting balls keep their state untouched
+        _mm_store_ps(&posX[i], BALL_SELECT(px, nx, act));
+        _mm_store_ps(&posY[i], BALL_SELECT(py, ny, act));
+        _mm_store_ps(&posZ[i], BALL_SELECT(pz, nz, act));
+        _mm_store_ps(&velX[i], BALL_SELECT(_mm_load_ps(&velX[i]), vx, act));
+        _mm_store_ps(&velY[i], BALL_SELECT(_mm_load_ps(&velY[i]), vy, act));
+        _mm_store_ps(&velZ[i], BALL_SELECT(_mm_load_ps(&velZ[i]), vz, act));
+        _mm_store_si128((__m128i*)&active[i], _mm_castps_si128(_mm_andnot_ps(rest, act)));
+    }
+#undef BALL_SELECT
+#endif
+
+    integrateScalar(i, count, deltaTime);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef BALL_SYSTEM_H
+#define BALL_SYSTEM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+// All balls of the scene in structure-of-arrays form. Each component lives in its own
+// 32-byte aligned array, so integrate() can run gravity, air drag and the floor-rest check
+// on 8 (AVX) or 4 (SSE2) balls per instruction. The physics is the same as Ball::applyPhysics.
+//
+// The kernel is chosen at compile time: AVX when the compiler targets it (/arch:AVX, -mavx),
+// otherwise SSE2 (always available on x64), otherwise plain scalar code.
+class BallSystem {
+public:
+    typedef std::vector<float, AlignedAllocator<float> > FloatArray;
+    typedef std::vector<uint32_t, AlignedAllocator<uint32_t> > MaskArray;
+
+    // same constants as Ball
+    static const float GRAVITY;        // along -y
+    static const float AIR_RESISTANCE; // quadratic drag coefficient, unit mass
+    static const float FLOOR_Y;        // balls come to rest on this plane
+
+    FloatArray posX, posY, posZ;
+    FloatArray prevX, prevY, prevZ; // positions before the last step, for render interpolation
+    FloatArray velX, velY, velZ;
+    FloatArray radius;
+    MaskArray active;               // all bits set while the ball is simulated, 0 once it rests
+    std::vector<unsigned int> texture;
+
+    size_t size() const {
+        return posX.size();
+    }
+
+    bool empty() const {
+        return posX.empty();
+    }
+
+    void reserve(size_t count);
+    void clear();
+    // returns the index of the new ball
+    size_t add(const glm::vec3& position, const glm::vec3& velocity, float radius, unsigned int texture);
+
+    // one physics step for every ball: gravity, quadratic drag, position update, floor rest
+    void integrate(float deltaTime);
+
+    glm::vec3 getPosition(size_t i) const {
+        return glm::vec3(posX[i], posY[i], posZ[i]);
+    }
+
+    glm::vec3 getVelocity(size_t i) const {
+        return glm::vec3(velX[i], velY[i], velZ[i]);
+    }
+
+    void setVelocity(size_t i, const glm::vec3& velocity) {
+        velX[i] = velocity.x;
+        velY[i] = velocity.y;
+        velZ[i] = velocity.z;
+    }
+
+    // position to draw at, alpha blends between the previous and the current physics step
+    glm::vec3 getRenderPosition(size_t i, float alpha) const {
+        return glm::mix(glm::vec3(prevX[i], prevY[i], prevZ[i]), getPosition(i), alpha);
+    }
+
+    bool isActive(size_t i) const {
+        return active[i] != 0;
+    }
+
+    void setActive(size_t i, bool act) {
+        active[i] = act ? 0xFFFFFFFFu : 0u;
+    }
+
+private:
+    void integrateScalar(size_t begin, size_t end, float deltaTime);
+};
+
+#endif // BALL_SYSTEM_H
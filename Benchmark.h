@@ -0,0 +1,341 @@
+#pragma once
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Options for the offscreen benchmark mode, filled from the command line:
+//   --benchmark [frames]   render a fixed number of frames offscreen and report timings
+//   --warmup <frames>      frames rendered before recording starts
+//   --bench-csv <path>     also write the per-frame timings to a CSV file
+//   --balls <count>        number of balls to spawn instead of the interactive default
+//   --particles <count>    fire particle pool size, also the particles emitted per step
+//   --particle-backend <cpu|compute>  where the fire particles are simulated
+//   --flames <count>       flames burning on the floor, 0 for none
+//   --shadow-culling <on|off>  cull shadow casters per cube map face, or let the geometry
+//                          shader draw everything into all six faces
+//   --shadow-quality <off|hard|pcf4|pcf20>  shadow filtering tier of the lighting shader
+//   --shadow-map <cube|paraboloid>  how the point light shadow is stored
+//   --shadow-tiers         run the benchmark once per shadow filtering tier and once with the
+//                          dual-paraboloid map, and compare them
+//   --collision-scaling    time the ball-ball broad phase from 1k to 100k balls and exit
+//   --particle-scaling     time the CPU particle update from 10k to 1M particles and exit
+//   --flame-scaling        time the flame on both backends from 1,800 to 1M particles, then
+//                          separate flames against one FlameManager, and exit
+struct BenchmarkOptions {
+    bool enabled = false;
+    int frames = 500;
+    int warmup = 30;
+    int balls = 0; // 0 keeps the interactive ball count
+    int particles = 0; // 0 keeps the interactive particle count
+    bool computeParticles = false;
+    int flames = -1; // -1 keeps the interactive flame count
+    bool shadowCulling = true;
+    std::string shadowQuality; // empty keeps the interactive tier
+    bool shadowTiers = false;
+    bool paraboloidShadows = false;
+    bool collisionScaling = false;
+    bool particleScaling = false;
+    bool flameScaling = false;
+    float frameDelta = 1.0f / 60.0f; // fixed simulation step so every run sees the same scene
+    std::string csvPath;
+};
+
+inline BenchmarkOptions parseBenchmarkArgs(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--benchmark") == 0) {
+            options.enabled = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                options.frames = std::max(1, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--bench-csv") == 0 && i + 1 < argc) {
+            options.csvPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+            options.balls = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+            options.particles = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--particle-backend") == 0 && i + 1 < argc) {
+            options.computeParticles = std::strcmp(argv[++i], "compute") == 0;
+        }
+        else if (std::strcmp(argv[i], "--flames") == 0 && i + 1 < argc) {
+            options.flames = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--shadow-culling") == 0 && i + 1 < argc) {
+            options.shadowCulling = std::strcmp(argv[++i], "off") != 0;
+        }
+        else if (std::strcmp(argv[i], "--shadow-quality") == 0 && i + 1 < argc) {
+            options.shadowQuality = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--shadow-map") == 0 && i + 1 < argc) {
+            options.paraboloidShadows = std::strcmp(argv[++i], "paraboloid") == 0;
+        }
+        else if (std::strcmp(argv[i], "--shadow-tiers") == 0) {
+            options.enabled = true;
+            options.shadowTiers = true;
+        }
+        else if (std::strcmp(argv[i], "--collision-scaling") == 0) {
+            options.collisionScaling = true;
+        }
+        else if (std::strcmp(argv[i], "--particle-scaling") == 0) {
+            options.particleScaling = true;
+        }
+        else if (std::strcmp(argv[i], "--flame-scaling") == 0) {
+            options.flameScaling = true;
+        }
+    }
+    return options;
+}
+
+#ifdef HEADLESS_EGL
+// A window-less GL context created through EGL. On Mesa this uses the surfaceless
+// platform, so it runs on llvmpipe without an X server.
+struct HeadlessContext {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+
+    bool create()
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+            std::cout << "Failed to initialize EGL display" << std::endl;
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint numConfigs = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+            std::cout << "Failed to choose EGL config" << std::endl;
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+
+        // prefer the same 4.6 core context the window path asks for, but accept older drivers
+        const EGLint versions[][2] = { { 4, 6 }, { 4, 5 }, { 4, 3 }, { 3, 3 } };
+        for (const auto& version : versions) {
+            const EGLint contextAttribs[] = {
+                EGL_CONTEXT_MAJOR_VERSION, version[0],
+                EGL_CONTEXT_MINOR_VERSION, version[1],
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+            };
+            context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+            if (context != EGL_NO_CONTEXT)
+                break;
+        }
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "Failed to create EGL context" << std::endl;
+            return false;
+        }
+        return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_TRUE;
+    }
+
+    void destroy()
+    {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+    }
+
+    static void* getProcAddress(const char* name)
+    {
+        return (void*)eglGetProcAddress(name);
+    }
+};
+#endif
+
+// Color + depth framebuffer the benchmark renders into instead of the default framebuffer.
+class OffscreenTarget {
+public:
+    unsigned int FBO = 0;
+    unsigned int width = 0, height = 0;
+
+    void create(unsigned int w, unsigned int h)
+    {
+        width = w;
+        height = h;
+        glGenFramebuffers(1, &FBO);
+        glGenRenderbuffers(1, &colorRBO);
+        glGenRenderbuffers(1, &depthRBO);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Offscreen framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void destroy()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &colorRBO);
+        glDeleteRenderbuffers(1, &depthRBO);
+        FBO = colorRBO = depthRBO = 0;
+    }
+
+private:
+    unsigned int colorRBO = 0, depthRBO = 0;
+};
+
+// Records CPU and GPU time for every frame. GPU time comes from a pair of GL_TIMESTAMP
+// queries per frame kept in a small ring, so results are read a few frames late and never
+// stall the pipeline. Timestamps (unlike GL_TIME_ELAPSED) can enclose the per-pass queries
+// of GpuProfiler.
+class FrameTimer {
+public:
+    static const int QUERY_LATENCY = 4;
+
+    void init()
+    {
+        glGenQueries(2 * QUERY_LATENCY, queries);
+    }
+
+    void beginFrame()
+    {
+        // the slot is about to be reused, collect the result it still holds
+        if (frameIndex >= QUERY_LATENCY)
+            collect(frameIndex - QUERY_LATENCY);
+        cpuStart = std::chrono::steady_clock::now();
+        glQueryCounter(queries[2 * (frameIndex % QUERY_LATENCY)], GL_TIMESTAMP);
+    }
+
+    void endFrame()
+    {
+        glQueryCounter(queries[2 * (frameIndex % QUERY_LATENCY) + 1], GL_TIMESTAMP);
+        auto cpuEnd = std::chrono::steady_clock::now();
+        cpuMs.push_back(std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count());
+        gpuMs.push_back(0.0);
+        frameIndex++;
+    }
+
+    // wait for the queries still in flight
+    void finish()
+    {
+        glFinish();
+        int first = std::max(0, frameIndex - QUERY_LATENCY);
+        for (int i = first; i < frameIndex; ++i)
+            collect(i);
+        glDeleteQueries(2 * QUERY_LATENCY, queries);
+    }
+
+    void report(std::ostream& out) const
+    {
+        out << "frames: " << cpuMs.size() << std::endl;
+        printSummary(out, "cpu", cpuMs);
+        printSummary(out, "gpu", gpuMs);
+    }
+
+    double averageCpu() const
+    {
+        return mean(cpuMs);
+    }
+
+    double averageGpu() const
+    {
+        return mean(gpuMs);
+    }
+
+    void writeCSV(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file) {
+            std::cout << "Failed to open benchmark csv: " << path << std::endl;
+            return;
+        }
+        file << "frame,cpu_ms,gpu_ms\n";
+        for (size_t i = 0; i < cpuMs.size(); ++i)
+            file << i << "," << cpuMs[i] << "," << gpuMs[i] << "\n";
+    }
+
+private:
+    unsigned int queries[2 * QUERY_LATENCY] = {};
+    int frameIndex = 0;
+    std::chrono::steady_clock::time_point cpuStart;
+    std::vector<double> cpuMs;
+    std::vector<double> gpuMs;
+
+    void collect(int frame)
+    {
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(queries[2 * (frame % QUERY_LATENCY)], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[2 * (frame % QUERY_LATENCY) + 1], GL_QUERY_RESULT, &end);
+        gpuMs[frame] = (end - start) / 1.0e6;
+    }
+
+    static void printSummary(std::ostream& out, const char* name, const std::vector<double>& samples)
+    {
+        if (samples.empty())
+            return;
+        std::vector<double> sorted(samples);
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (double s : sorted)
+            sum += s;
+        out << name << " ms: min " << sorted.front()
+            << "  avg " << sum / sorted.size()
+            << "  p95 " << percentile(sorted, 0.95)
+            << "  p99 " << percentile(sorted, 0.99)
+            << "  max " << sorted.back() << std::endl;
+    }
+
+    static double mean(const std::vector<double>& samples)
+    {
+        double sum = 0.0;
+        for (double s : samples)
+            sum += s;
+        return samples.empty() ? 0.0 : sum / samples.size();
+    }
+
+    // nearest-rank percentile of an already sorted sample
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t rank = (size_t)(p * sorted.size() + 0.999999);
+        rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+        return sorted[rank - 1];
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "ComputeParticles.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cstddef>
+
+bool ComputeParticles::supported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+ComputeParticles::ComputeParticles(unsigned int capacity)
+    : particleCapacity(capacity), current(0), seed(0), quadVBO(0),
+      emitShader("particle_emit_cs.vs", Shader::readFile("random.glsl")), updateShader("particle_update_cs.vs") {
+    // same quad as ParticleGenerator::init
+    float particle_quad[] = {
+        0.0f, 1.0f, 0.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f,
+
+        0.0f, 1.0f, 0.0f, 1.0f,
+        1.0f, 1.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 0.0f
+    };
+    glGenBuffers(1, &quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
+
+    glGenBuffers(2, particleBuffers);
+    glGenBuffers(2, commandBuffers);
+    glGenVertexArrays(2, VAOs);
+    const DrawCommand command = { 6, 0, 0, 0, 0 };
+    for (int i = 0; i < 2; ++i) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleBuffers[i]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)capacity * sizeof(GpuParticle), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffers[i]);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand), &command, GL_DYNAMIC_DRAW);
+
+        // particle.vs reads the quad corner from attribute 0 and the per-instance
+        // position and color straight out of the particle buffer
+        glBindVertexArray(VAOs[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, particleBuffers[i]);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (void*)offsetof(GpuParticle, positionLife));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (void*)offsetof(GpuParticle, color));
+        glVertexAttribDivisor(2, 1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+ComputeParticles::~ComputeParticles() {
+    glDeleteVertexArrays(2, VAOs);
+    glDeleteBuffers(2, particleBuffers);
+    glDeleteBuffers(2, commandBuffers);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteProgram(emitShader.ID);
+    glDeleteProgram(updateShader.ID);
+}
+
+void ComputeParticles::emit(const glm::vec3& position, const glm::vec3& velocity, unsigned int count, unsigned int limit) {
+    dispatchEmit(position, velocity, glm::vec3(0.0f), count, std::min(limit, particleCapacity), false, 1.0f);
+}
+
+void ComputeParticles::emitSparks(const glm::vec3& position, const glm::vec3& velocity, const glm::vec3& offset, unsigned int count, bool isAdd) {
+    dispatchEmit(position, velocity, offset, count, particleCapacity, true, isAdd ? 1.0f : -1.0f);
+}
+
+void ComputeParticles::dispatchEmit(const glm::vec3& position, const glm::vec3& velocity, const glm::vec3& offset,
+    unsigned int count, unsigned int limit, bool sparks, float sparkSign) {
+    if (count == 0)
+        return;
+    PROFILE_SCOPE("ComputeParticles::emit");
+    emitShader.use();
+    emitShader.setUint("emitCount", count);
+    emitShader.setUint("limit", limit);
+    emitShader.setUint("seed", seed++);
+    emitShader.setVec3("emitterPosition", position);
+    emitShader.setVec3("emitterVelocity", velocity);
+    emitShader.setVec3("offset", offset);
+    emitShader.setBool("sparks", sparks);
+    emitShader.setFloat("sparkSign", sparkSign);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleBuffers[current]);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, commandBuffers[current]);
+    glDispatchCompute((count + 63) / 64, 1, 1);
+    glMemoryBarrier(BARRIERS);
+}
+
+void ComputeParticles::update(float deltaTime) {
+    PROFILE_SCOPE("ComputeParticles::update");
+    unsigned int next = 1 - current;
+    resetAliveCount(next);
+
+    updateShader.use();
+    updateShader.setFloat("deltaTime", deltaTime);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleBuffers[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, particleBuffers[next]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffers[current]);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, commandBuffers[next]);
+    // the live count is only known on the GPU: dispatch for the whole capacity, threads past
+    // the live count return at once
+    glDispatchCompute((particleCapacity + 255) / 256, 1, 1);
+    glMemoryBarrier(BARRIERS);
+    current = next;
+}
+
+void ComputeParticles::draw() {
+    glBindVertexArray(VAOs[current]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffers[current]);
+    glDrawArraysIndirect(GL_TRIANGLES, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void ComputeParticles::clear() {
+    const DrawCommand command = { 6, 0, 0, 0, 0 };
+    for (int i = 0; i < 2; ++i) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffers[i]);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawCommand), &command);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void ComputeParticles::resetAliveCount(unsigned int buffer) {
+    const GLuint zero = 0;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffers[buffer]);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offsetof(DrawCommand, instanceCount), sizeof(GLuint), &zero);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void ComputeParticles::readCounters(unsigned int& alive, unsigned int& overflowed) {
+    DrawCommand commands[2];
+    for (int i = 0; i < 2; ++i) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffers[i]);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawCommand), &commands[i]);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    alive = commands[current].instanceCount;
+    overflowed = commands[0].overflow + commands[1].overflow;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef COMPUTE_PARTICLES_H
+#define COMPUTE_PARTICLES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+// GPU backend of ParticleGenerator (GL 4.3). Particle state lives in two shader storage
+// buffers; emission, aging and death run in compute shaders, and the live count is kept
+// by an atomic counter inside the indirect draw command, so the CPU never reads or writes
+// per-particle data.
+//
+// Every update reads the live particles of one buffer and appends the survivors to the
+// other one, which keeps them packed. Each buffer has its own draw command:
+//   { vertexCount = 6, instanceCount = live particles, first = 0, baseInstance = 0, overflow }
+// where overflow counts emitted particles dropped because the buffer was full.
+class ComputeParticles {
+public:
+    // needs a GL 4.3 context for compute shaders and indirect draws
+    static bool supported();
+
+    explicit ComputeParticles(unsigned int capacity);
+    ~ComputeParticles();
+
+    // appends count fire particles around the emitter (same ranges as the CPU path); fire
+    // particles past limit live ones are dropped, sparks may fill the whole capacity
+    void emit(const glm::vec3& position, const glm::vec3& velocity, unsigned int count, unsigned int limit);
+    // appends count sparks at position + offset, pushed along (isAdd) or against the random direction
+    void emitSparks(const glm::vec3& position, const glm::vec3& velocity, const glm::vec3& offset, unsigned int count, bool isAdd);
+    // ages and moves every live particle, dead ones are dropped
+    void update(float deltaTime);
+    // draws the live particles with the bound particle shader, one indirect instanced draw
+    void draw();
+    // empties both buffers and the overflow counts
+    void clear();
+
+    // reads the counters back; this waits for the GPU, so only call it for reports
+    void readCounters(unsigned int& alive, unsigned int& overflowed);
+
+    unsigned int capacity() const {
+        return particleCapacity;
+    }
+
+private:
+    // std430 layout of a particle in the shaders
+    struct GpuParticle {
+        glm::vec4 positionLife;
+        glm::vec4 velocity;
+        glm::vec4 color;
+    };
+
+    struct DrawCommand {
+        GLuint vertexCount;
+        GLuint instanceCount;
+        GLuint first;
+        GLuint baseInstance;
+        GLuint overflow;
+    };
+
+    // shader writes that the next dispatch, draw or buffer update reads
+    static const GLbitfield BARRIERS = GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT;
+
+    unsigned int particleCapacity;
+    unsigned int current; // buffer holding the live particles
+    unsigned int seed;
+    unsigned int quadVBO;
+    unsigned int particleBuffers[2];
+    unsigned int commandBuffers[2];
+    unsigned int VAOs[2];
+    Shader emitShader;
+    Shader updateShader;
+
+    ComputeParticles(const ComputeParticles&) = delete;
+    ComputeParticles& operator=(const ComputeParticles&) = delete;
+
+    void dispatchEmit(const glm::vec3& position, const glm::vec3& velocity, const glm::vec3& offset,
+        unsigned int count, unsigned int limit, bool sparks, float sparkSign);
+    void resetAliveCount(unsigned int buffer);
+};
+
+#endif // COMPUTE_PARTICLES_H
@@ -0,0 +1,110 @@
+#include "CpuProfiler.h"
+
+#ifdef CPU_PROFILER_ENABLED
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace CpuProfiler {
+
+    struct Event {
+        const char* name;
+        long long begin;
+        long long end;
+    };
+
+    // Fixed-size ring of events written only by its own thread. When it is full the oldest
+    // events are overwritten, so a long session keeps the most recent history.
+    struct ThreadBuffer {
+        static const size_t CAPACITY = 1 << 16;
+
+        std::vector<Event> events;
+        size_t next = 0;
+        bool wrapped = false;
+        unsigned int threadId = 0;
+
+        ThreadBuffer() : events(CAPACITY) {}
+
+        void push(const char* name, long long begin, long long end) {
+            events[next] = { name, begin, end };
+            next++;
+            if (next == CAPACITY) {
+                next = 0;
+                wrapped = true;
+            }
+        }
+    };
+
+    // every thread buffer ever created; they are kept alive so a trace can still be written
+    // after a worker thread has exited
+    static std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<ThreadBuffer*>& registry() {
+        static std::vector<ThreadBuffer*> buffers;
+        return buffers;
+    }
+
+    static ThreadBuffer& threadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            buffer = new ThreadBuffer();
+            std::lock_guard<std::mutex> lock(registryMutex());
+            buffer->threadId = (unsigned int)registry().size() + 1;
+            registry().push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    long long nowMicros() {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void record(const char* name, long long beginMicros, long long endMicros) {
+        threadBuffer().push(name, beginMicros, endMicros);
+    }
+
+    static void writeEscaped(std::ofstream& file, const char* text) {
+        for (const char* c = text; *c; ++c) {
+            if (*c == '"' || *c == '\\')
+                file << '\\';
+            file << *c;
+        }
+    }
+
+    // other threads should be idle while this runs; their buffers are read without locking
+    bool writeChromeTrace(const std::string& path) {
+        std::ofstream file(path);
+        if (!file) {
+            std::cout << "Failed to open CPU trace file: " << path << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(registryMutex());
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (ThreadBuffer* buffer : registry()) {
+            size_t count = buffer->wrapped ? ThreadBuffer::CAPACITY : buffer->next;
+            size_t start = buffer->wrapped ? buffer->next : 0;
+            for (size_t i = 0; i < count; ++i) {
+                const Event& event = buffer->events[(start + i) % ThreadBuffer::CAPACITY];
+                file << (first ? "\n" : ",\n");
+                file << "{\"name\":\"";
+                writeEscaped(file, event.name);
+                file << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":" << event.begin
+                    << ",\"dur\":" << (event.end - event.begin)
+                    << ",\"pid\":1,\"tid\":" << buffer->threadId << "}";
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+        return true;
+    }
+}
+
+#endif
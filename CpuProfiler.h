@@ -0,0 +1,52 @@
+#pragma once
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+// Scoped CPU profiler. PROFILE_SCOPE("name") records the begin/end time of the enclosing
+// block into a ring buffer owned by the calling thread; PROFILE_WRITE_TRACE(path) writes
+// everything recorded so far as a chrome://tracing / Perfetto JSON file.
+//
+// Release builds (NDEBUG) compile all of it out. Define CPU_PROFILER to keep it in an
+// optimized build.
+#if !defined(NDEBUG) || defined(CPU_PROFILER)
+#define CPU_PROFILER_ENABLED 1
+#endif
+
+#ifdef CPU_PROFILER_ENABLED
+
+#include <string>
+
+namespace CpuProfiler {
+    // microseconds since the first profiler call
+    long long nowMicros();
+    // name must outlive the profiler (string literals)
+    void record(const char* name, long long beginMicros, long long endMicros);
+    bool writeChromeTrace(const std::string& path);
+
+    class Scope {
+    public:
+        explicit Scope(const char* name) : name(name), begin(nowMicros()) {}
+        ~Scope() { record(name, begin, nowMicros()); }
+
+    private:
+        const char* name;
+        long long begin;
+
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+    };
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) CpuProfiler::Scope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_WRITE_TRACE(path) CpuProfiler::writeChromeTrace(path)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_WRITE_TRACE(path) ((void)0)
+
+#endif
+
+#endif // CPU_PROFILER_H
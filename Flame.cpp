@@ -1,56 +1,75 @@
 ﻿#include "Flame.h"
+#include "CpuProfiler.h"
+#include "TextureCache.h"
 
 namespace Flame {
 
-	Flame::Flame()
+	Flame::Flame(FlameBackend backend, int maxParticles, unsigned int seed)
 	{
 		//glGetError();
+		if (backend == FLAME_COMPUTE && !FlameCompute::supported())
+		{
+			std::cout << "Flame: compute shaders need OpenGL 4.3, using transform feedback" << std::endl;
+			backend = FLAME_TRANSFORM_FEEDBACK;
+		}
+		mBackend = backend;
+		mMaxParticles = maxParticles;
+		mLaunchers = (int)((long long)maxParticles * INIT_PARTICLES / MAX_PARTICLES);
+		mCompute = nullptr;
+		mSeed = seed;
+		mFrame = 0;
 		mCurVBOIndex = 0;
 		mCurTransformFeedbackIndex = 1;
 		mFirst = true;
 		mTimer = 0;
-		const GLchar* varyings[7] = { "Type1","Position1",
-			"Velocity1","Age1",
-			"Alpha1","Size1",
-			"Life1"
-		};//设置TransformFeedback要捕获的输出变量
+		const GLchar* varyings[4] = { "Position1",
+			"VelocityXY1","VelocityZTypeAlpha1",
+			"AgeLife1"
+		};//设置TransformFeedback要捕获的输出变量，顺序与FlameParticle一致
+		//打包的粒子格式（flame_particle.glsl）要放在最前面，其中可能启用扩展
+		std::string particle = Shader::readFile("./flame_particle.glsl");
 		mUpdateShader = new Shader("./flame_update.vs", "./flame_update_fs.vs",
-			"./flame_update_gs.vs", varyings, 7);
+			"./flame_update_gs.vs", varyings, 4, particle + Shader::readFile("./random.glsl"));
 		//设置TransformFeedback缓存能够记录的顶点的数据类型
 
-		mRenderShader = new Shader("./flame_render.vs", "./flame_render_fs.vs");
-		//设置随机纹理
-		InitRandomTexture(580);
-		mSparkTexture = loadTexture("texture/particle.bmp");
-		mStartTexture = loadTexture("texture/flame.bmp");
+		mRenderShader = new Shader("./flame_render.vs", "./flame_render_fs.vs", nullptr, particle);
+		mSparkTexture = TextureCache::instance().load("texture/particle.bmp");
+		mStartTexture = TextureCache::instance().load("texture/flame.bmp");
 		mRenderShader->use();
 		mRenderShader->setInt("flameSpark", 0);
 		mRenderShader->setInt("flameStart", 1);
-		glm::vec3 pos(0.0, 0.0, -3.0f);
-		InitFlame(pos);
 		this->position = glm::vec3(0.0f, 0.3f, 0.0f);
 		this->modelMatrix = glm::mat4(1.0f);
 		this->velocity = glm::vec3(0.5f, 0.4f, 0.0f);
 		this->radius = 0.01f;
 		this->gravity = 1.0f;
-		//根据velocity计算最大最小速度
+		//根据velocity计算最大最小速度，GenInitLocation要用
 		updateMaxMinVelocity();
+		glm::vec3 pos(0.0, 0.0, -3.0f);
+		InitFlame(pos);
 	}
 
 
 	Flame::~Flame()
 	{
+		delete mCompute;
+		glDeleteTransformFeedbacks(2, mTransformFeedbacks);
+		glDeleteBuffers(2, mParticleBuffers);
+		glDeleteVertexArrays(2, mParticleArrays);
+		glDeleteProgram(mUpdateShader->ID);
+		glDeleteProgram(mRenderShader->ID);
+		delete mUpdateShader;
+		delete mRenderShader;
 	}
 
 	bool Flame::InitFlame(glm::vec3& pos)
 	{
-		FlameParticle particles[MAX_PARTICLES];
-		memset(particles, 0, sizeof(particles));
-		particles[0].type = PARTICLE_TYPE_LAUNCHER;//设置第一个粒子的类型为发射器
-		particles[0].position = pos;
-		particles[0].lifetimeMills = 0.0f;
-		particles[0].velocity = glm::vec3(0.0f, 0.1f, 0.0f);
-		GenInitLocation(particles, INIT_PARTICLES);
+		std::vector<FlameParticle> particles(mMaxParticles);
+		memset(particles.data(), 0, particles.size() * sizeof(FlameParticle));
+		//设置第一个粒子的类型为发射器
+		particles[0] = packFlameParticle(PARTICLE_TYPE_LAUNCHER, pos, glm::vec3(0.0f, 0.1f, 0.0f), 0.0f, 0.0f, 0.0f);
+		GenInitLocation(particles.data(), mLaunchers);
+		// both paths get names, so the destructor does not care which one is used
 		glGenTransformFeedbacks(2, mTransformFeedbacks);
 		glGenBuffers(2, mParticleBuffers);
 		glGenVertexArrays(2, mParticleArrays);
@@ -59,15 +78,24 @@ namespace Flame {
 			glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, mTransformFeedbacks[i]);
 			glBindBuffer(GL_ARRAY_BUFFER, mParticleBuffers[i]);
 			glBindVertexArray(mParticleArrays[i]);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(particles), particles, GL_DYNAMIC_DRAW);
+			// the compute path keeps its own buffers
+			if (mBackend == FLAME_TRANSFORM_FEEDBACK)
+				glBufferData(GL_ARRAY_BUFFER, particles.size() * sizeof(FlameParticle), particles.data(), GL_DYNAMIC_DRAW);
 			glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, mParticleBuffers[i]);
 		}
 		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
 		glBindVertexArray(0);
-		//绑定纹理
-		mUpdateShader->use();
-		glBindTexture(GL_TEXTURE_1D, mRandomTexture);
-		mUpdateShader->setInt("gRandomTexture", 0);
+		if (mBackend == FLAME_COMPUTE)
+		{
+			// a pool with this one flame; it stays at the origin, modelMatrix places it
+			mCompute = new FlameCompute(mSeed);
+			std::vector<FlameParticle> launchers(particles.begin(), particles.begin() + mLaunchers);
+			mCompute->addFlame(launchers, mMaxParticles - mLaunchers);
+			mCompute->renderShader().use();
+			mCompute->renderShader().setInt("flameSpark", 0);
+			mCompute->renderShader().setInt("flameStart", 1);
+			return true;
+		}
 		return true;
 	}
 
@@ -91,6 +119,13 @@ namespace Flame {
 
 	void Flame::UpdateParticles(float frametimeMills)
 	{
+		PROFILE_SCOPE("Flame::UpdateParticles");
+		if (mCompute)
+		{
+			mCompute->setFlame(0, glm::vec3(0.0f), MAX_VELOC, MIN_VELOC);
+			mCompute->update(frametimeMills, MAX_LIFE, MIN_LIFE, r);
+			return;
+		}
 		mUpdateShader->use();
 		mUpdateShader->setFloat("gDeltaTimeMillis", frametimeMills);
 		//mUpdateShader->setFloat("gTime", mTimer);
@@ -98,48 +133,36 @@ namespace Flame {
 		mUpdateShader->setFloat("MIN_LIFE", MIN_LIFE);
 		mUpdateShader->setVec3("MAX_VELOC", MAX_VELOC);
 		mUpdateShader->setVec3("MIN_VELOC", MIN_VELOC);
-
-		//绑定纹理
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_1D, mRandomTexture);
-		//mUpdateShader->setInt("gRandomTexture",0);
+		mUpdateShader->setFloat("r", r);
+		mUpdateShader->setUint("gFrame", mFrame++);
+		mUpdateShader->setUint("gSeed", mSeed);
 
 		glEnable(GL_RASTERIZER_DISCARD);//我们渲染到TransformFeedback缓存中去，并不需要光栅化
 		glBindVertexArray(mParticleArrays[mCurVBOIndex]);
 		glBindBuffer(GL_ARRAY_BUFFER, mParticleBuffers[mCurVBOIndex]);
 		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, mTransformFeedbacks[mCurTransformFeedbackIndex]);
 
-		glEnableVertexAttribArray(0);//type
-		glEnableVertexAttribArray(1);//position
-		glEnableVertexAttribArray(2);//velocity
-		glEnableVertexAttribArray(3);//lifetime
-		glEnableVertexAttribArray(4);//alpha
-		glEnableVertexAttribArray(5);//size
-		glEnableVertexAttribArray(6);//life
-		glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, type));
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, position));
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, velocity));
-		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, lifetimeMills));
-		glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, alpha));
-		glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, size));
-		glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, life));
+		// locations as declared in flame_update.vs; the packed words stay integers
+		glEnableVertexAttribArray(3);//position
+		glEnableVertexAttribArray(4);//velocity x,y
+		glEnableVertexAttribArray(5);//velocity z, type, alpha
+		glEnableVertexAttribArray(6);//age, life
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, position));
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(FlameParticle), (void*)offsetof(FlameParticle, velocityXY));
+		glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(FlameParticle), (void*)offsetof(FlameParticle, velocityZTypeAlpha));
+		glVertexAttribIPointer(6, 1, GL_UNSIGNED_INT, sizeof(FlameParticle), (void*)offsetof(FlameParticle, ageLife));
 		glBeginTransformFeedback(GL_POINTS);
 		if (mFirst)
 		{
-			glDrawArrays(GL_POINTS, 0, INIT_PARTICLES);
+			glDrawArrays(GL_POINTS, 0, mLaunchers);
 			mFirst = false;
 		}
 		else {
 			glDrawTransformFeedback(GL_POINTS, mTransformFeedbacks[mCurVBOIndex]);
 		}
 		glEndTransformFeedback();
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glDisableVertexAttribArray(3);
-		glDisableVertexAttribArray(4);
-		glDisableVertexAttribArray(5);
-		glDisableVertexAttribArray(6);
+		for (int i = 3; i <= 6; i++)
+			glDisableVertexAttribArray(i);
 		glDisable(GL_RASTERIZER_DISCARD);
 		glBindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -153,159 +176,114 @@ namespace Flame {
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
 
-		mRenderShader->use();
-		mRenderShader->setMat4("model", worldMatrix);
-		mRenderShader->setMat4("view", viewMatrix);
-		mRenderShader->setMat4("projection", projectMatrix);
+		Shader* shader = mCompute ? &mCompute->renderShader() : mRenderShader;
+		shader->use();
+		shader->setMat4("model", worldMatrix);
+		shader->setMat4("view", viewMatrix);
+		shader->setMat4("projection", projectMatrix);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, mSparkTexture);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, mStartTexture);
+		if (mCompute)
+		{
+			mCompute->draw();
+			glActiveTexture(GL_TEXTURE0);
+			glDisable(GL_BLEND);
+			return;
+		}
+
 		glBindVertexArray(mParticleArrays[mCurTransformFeedbackIndex]);
 		glBindBuffer(GL_ARRAY_BUFFER, mParticleBuffers[mCurTransformFeedbackIndex]);
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
+		// locations as declared in flame_render.vs
+		// the velocity is not needed for drawing
 		glEnableVertexAttribArray(3);
 		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, position));
-		glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, alpha));
-		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, size));
-		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, lifetimeMills));
-		glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, life));
+		glEnableVertexAttribArray(5);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(FlameParticle), (void*)offsetof(FlameParticle, position));
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(FlameParticle), (void*)offsetof(FlameParticle, velocityZTypeAlpha));
+		glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(FlameParticle), (void*)offsetof(FlameParticle, ageLife));
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, mSparkTexture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, mStartTexture);
 		glDrawTransformFeedback(GL_POINTS, mTransformFeedbacks[mCurTransformFeedbackIndex]);
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glDisableVertexAttribArray(3);
-		glDisableVertexAttribArray(4);
+		for (int i = 3; i <= 5; i++)
+			glDisableVertexAttribArray(i);
 		glBindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glActiveTexture(GL_TEXTURE0);
 
 		glDisable(GL_BLEND);
 	}
 
 
-	void Flame::InitRandomTexture(unsigned int size)
+	void Flame::GenInitLocation(FlameParticle particles[], int nums)
 	{
-		srand(time(NULL));
-		glm::vec3* pRandomData = new glm::vec3[size];
-		for (int i = 0; i < size; i++)
-		{
-			pRandomData[i].x = float(rand()) / float(RAND_MAX);
-			pRandomData[i].y = float(rand()) / float(RAND_MAX);
-			pRandomData[i].z = float(rand()) / float(RAND_MAX);
-		}
-		glGenTextures(1, &mRandomTexture);
-		glBindTexture(GL_TEXTURE_1D, mRandomTexture);
-		glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB, size, 0, GL_RGB, GL_FLOAT, pRandomData);
-		glTexParameterf(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameterf(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		delete[] pRandomData;
-		pRandomData = nullptr;
+		genLaunchers(particles, nums, MAX_VELOC, MIN_VELOC, mSeed);
 	}
 
-	void Flame::GenInitLocation(FlameParticle particles[], int nums)
+	void Flame::updateMaxMinVelocity()
 	{
-		srand(time(NULL));
+		velocityRange(velocity, MAX_VELOC, MIN_VELOC);
+		DEL_VELOC = MAX_VELOC - MIN_VELOC;
+	}
+
+	void genLaunchers(FlameParticle particles[], int count, const glm::vec3& maxVelocity, const glm::vec3& minVelocity, unsigned int seed)
+	{
+		// own generator: same seed, same launchers, and the global rand() sequence stays untouched
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
 		int n = 10;
-		float Adj_value = 0.05f;
 		float radius_fire = 0.001f;//火焰地区半径
-		for (int x = 0; x < nums; x++) {
+		for (int x = 0; x < count; x++) {
 			glm::vec3 record(0.0f);
 			for (int y = 0; y < n; y++) {//生成高斯分布的粒子，中心多，外边少
-				record.x += (2.0f * float(rand()) / float(RAND_MAX) - 1.0f);
-				record.z += (2.0f * float(rand()) / float(RAND_MAX) - 1.0f);
+				record.x += (2.0f * unit(generator) - 1.0f);
+				record.z += (2.0f * unit(generator) - 1.0f);
 			}
 			record.x *= radius_fire;
 			record.z *= radius_fire;
 			record.y = center.y;
-			particles[x].type = PARTICLE_TYPE_LAUNCHER;
-			particles[x].position = record;
-			particles[x].velocity = DEL_VELOC * (float(rand()) / float(RAND_MAX)) + MIN_VELOC;//在最大最小速度之间随机选择
-			particles[x].alpha = 1.0f;
-			particles[x].size = INIT_SIZE;//发射器粒子大小
+			glm::vec3 velocity = (maxVelocity - minVelocity) * unit(generator) + minVelocity;//在最大最小速度之间随机选择
 			//在最短最长寿命之间随机选择
-			particles[x].lifetimeMills = (MAX_LIFE - MIN_LIFE) * (float(rand()) / float(RAND_MAX)) + MIN_LIFE;
-			float dist = sqrt(record.x * record.x + record.z * record.z);
-			particles[x].life = particles[x].lifetimeMills;
+			float life = (MAX_LIFE - MIN_LIFE) * unit(generator) + MIN_LIFE;
+			//发射器粒子大小固定为INIT_SIZE，由着色器根据类型给出
+			particles[x] = packFlameParticle(PARTICLE_TYPE_LAUNCHER, record, velocity, 1.0f, life, life);
 		}
 	}
 
-	void Flame::updateMaxMinVelocity()
+	void velocityRange(const glm::vec3& velocity, glm::vec3& maxVelocity, glm::vec3& minVelocity)
 	{
 		float max_coeff = 2.0f;
 		float min_coeff = 0.5f;
-		if (this->velocity.x >= 0) {
-			MAX_VELOC.x = velocity.x * max_coeff;
-			MIN_VELOC.x = velocity.x * min_coeff;
+		if (velocity.x >= 0) {
+			maxVelocity.x = velocity.x * max_coeff;
+			minVelocity.x = velocity.x * min_coeff;
 		}
 		else {
-			MAX_VELOC.x = velocity.x * min_coeff;
-			MIN_VELOC.x = velocity.x * max_coeff;
+			maxVelocity.x = velocity.x * min_coeff;
+			minVelocity.x = velocity.x * max_coeff;
 		}
 
-		if (this->velocity.y >= 0) {
-			MAX_VELOC.y = velocity.y * max_coeff;
-			MIN_VELOC.y = velocity.y * min_coeff;
+		if (velocity.y >= 0) {
+			maxVelocity.y = velocity.y * max_coeff;
+			minVelocity.y = velocity.y * min_coeff;
 		}
 		else {
-			MAX_VELOC.y = velocity.y * min_coeff;
-			MIN_VELOC.y = velocity.y * max_coeff;
+			maxVelocity.y = velocity.y * min_coeff;
+			minVelocity.y = velocity.y * max_coeff;
 		}
 
-		if (this->velocity.z >= 0) {
-			MAX_VELOC.z = velocity.z * max_coeff;
-			MIN_VELOC.z = velocity.z * min_coeff;
+		if (velocity.z >= 0) {
+			maxVelocity.z = velocity.z * max_coeff;
+			minVelocity.z = velocity.z * min_coeff;
 		}
 		else {
-			MAX_VELOC.z = velocity.z * min_coeff;
-			MIN_VELOC.z = velocity.z * max_coeff;
+			maxVelocity.z = velocity.z * min_coeff;
+			minVelocity.z = velocity.z * max_coeff;
 		}
 
 		//反向
-		MAX_VELOC = -MAX_VELOC;
-		MIN_VELOC = -MIN_VELOC;
-
-		DEL_VELOC = MAX_VELOC - MIN_VELOC;
+		maxVelocity = -maxVelocity;
+		minVelocity = -minVelocity;
 	}
 
-	unsigned int Flame::loadTexture(const char* path)
-	{
-		unsigned int textureID;
-		glGenTextures(1, &textureID);
-
-		int width, height, nrComponents;
-		unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-		if (data)
-		{
-			GLenum format;
-			if (nrComponents == 1)
-				format = GL_RED;
-			else if (nrComponents == 3)
-				format = GL_RGB;
-			else if (nrComponents == 4)
-				format = GL_RGBA;
-
-			glBindTexture(GL_TEXTURE_2D, textureID);
-			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Texture failed to load at path: " << path << std::endl;
-			stbi_image_free(data);
-		}
-
-		return textureID;
-	}
 }
\ No newline at end of file
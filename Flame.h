@@ -1,20 +1,26 @@
 #pragma once
-#include "stb_image.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <ctime>
 #include <math.h>
+#include <random>
+#include <vector>
 
+#include "FlameCompute.h"
 #include "Shader.h"
 
 namespace Flame {
-#define PARTICLE_TYPE_LAUNCHER 0.0f
-#define PARTICLE_TYPE_SHELL 1.0f
+#define PARTICLE_TYPE_LAUNCHER 0u
+#define PARTICLE_TYPE_SHELL 1u
+#define PARTICLE_TYPE_DEAD 2u // free slot, compute path only
+	//Χ룩flame_particle.glslһ
+#define FLAME_AGE_RANGE 1000.0f
 	//ٶ
 //#define MAX_VELOC glm::vec3(0.0,5.0,0.0)
 //	//Сٶ
@@ -25,7 +31,7 @@ namespace Flame {
 #define MAX_LIFE 2.0f*100
 	//
 #define MIN_LIFE 1.0f*100  
-	//ʼ㾫С
+	//ʼ㾫СɫΪflame_particle.glslFLAME_INIT_SIZE
 #define INIT_SIZE 30.0f;
 
 	const int MAX_PARTICLES = 1800;//ӷϵͳ
@@ -37,24 +43,56 @@ namespace Flame {
 
 
 
+	// packed to 24 bytes, the layout of flame_particle.glsl; the point size is derived
+	// from the type and alpha in the render shaders
 	struct FlameParticle
 	{
-		float type;
 		glm::vec3 position;
-		glm::vec3 velocity;
-		float lifetimeMills;//
-		float alpha;//alphaͨ
-		float size;//ӵ㾫С
-		float life;//
+		GLuint velocityXY;//ٶx,y뾫
+		GLuint velocityZTypeAlpha;//ٶz뾫(0-15λ)alpha(16-29λ)(30-31λ)
+		GLuint ageLife;//(16λ)(16λ)FLAME_AGE_RANGE16λ
+	};
+
+	// CPU side of the packing in flame_particle.glsl
+	inline FlameParticle packFlameParticle(GLuint type, const glm::vec3& position, const glm::vec3& velocity,
+		float alpha, float age, float life)
+	{
+		FlameParticle p;
+		p.position = position;
+		p.velocityXY = glm::packHalf2x16(glm::vec2(velocity.x, velocity.y));
+		GLuint a = (GLuint)(glm::clamp(alpha, 0.0f, 1.0f) * 16383.0f + 0.5f);
+		p.velocityZTypeAlpha = (GLuint)glm::packHalf1x16(velocity.z) | (a << 16) | (type << 30);
+		p.ageLife = glm::packUnorm2x16(glm::vec2(age, life) / FLAME_AGE_RANGE);
+		return p;
+	}
+
+	inline void setFlameParticleType(FlameParticle& p, GLuint type)
+	{
+		p.velocityZTypeAlpha = (p.velocityZTypeAlpha & 0x3FFFFFFFu) | (type << 30);
+	}
+
+	//velocity˶ʱӳٶȵķΧ򷴷˶
+	void velocityRange(const glm::vec3& velocity, glm::vec3& maxVelocity, glm::vec3& minVelocity);
+	//ڻĸcountĶ࣬٣ͬһseedͬķ
+	void genLaunchers(FlameParticle particles[], int count, const glm::vec3& maxVelocity, const glm::vec3& minVelocity, unsigned int seed);
+
+	// how the particles are simulated; both draw the same particles with the same shaders
+	enum FlameBackend
+	{
+		FLAME_TRANSFORM_FEEDBACK, // geometry shader + transform feedback ping-pong
+		FLAME_COMPUTE             // FlameCompute, needs GL 4.3
 	};
 
 	class Flame
 	{
 	public:
-		Flame();
+		// maxParticles scales the launchers with it (INIT_PARTICLES of MAX_PARTICLES).
+		// seed drives the initial launchers and the emission randomness: same seed, same run
+		Flame(FlameBackend backend = FLAME_TRANSFORM_FEEDBACK, int maxParticles = MAX_PARTICLES, unsigned int seed = 1);
 		~Flame();
 		void Render(float frametimeMills, glm::mat4 viewMatrix, glm::mat4& projectMatrix);
 		void update(float frametimeMills);
+		FlameBackend getBackend() const { return mBackend; }
 
 		float radius;
 		float gravity;
@@ -70,23 +108,26 @@ namespace Flame {
 	private:
 		bool InitFlame(glm::vec3& pos);
 		void UpdateParticles(float frametimeMills);//ӵλõ
-		void InitRandomTexture(unsigned int size);//1ά
 		void RenderParticles(glm::mat4& worldMatrix, glm::mat4& viewMatrix, glm::mat4& projectMatrix);
 		void GenInitLocation(FlameParticle partciles[], int nums);//ɳʼ
 		void updateMaxMinVelocity();
-		unsigned int loadTexture(const char* path);
 
 		unsigned int mCurVBOIndex, mCurTransformFeedbackIndex;
 		GLuint mParticleBuffers[2]; //ӷϵͳ㻺
 		GLuint mParticleArrays[2];
 		GLuint mTransformFeedbacks[2];//ӷϵͳӦTransformFeedback
-		GLuint mRandomTexture;//һά
+		unsigned int mSeed;//
+		unsigned int mFrame;//Ѹµ֡ɫӵһ
 		unsigned int mSparkTexture;//Alpha
 		unsigned int mStartTexture;
 		float mTimer;//ӷѾʱ
 		bool mFirst;
 		Shader* mUpdateShader;//ӵGPUProgram
 		Shader* mRenderShader;//ȾӵGPUProgram
+		FlameBackend mBackend;
+		int mMaxParticles;
+		int mLaunchers;
+		FlameCompute* mCompute; // nullptr on the transform feedback path
 	};
 
 }
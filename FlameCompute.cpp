@@ -0,0 +1,289 @@
+#include "FlameCompute.h"
+#include "Flame.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+namespace Flame {
+
+	// a new buffer of size bytes that starts with the first keep bytes of buffer; buffer is deleted
+	static GLuint resizeBuffer(GLuint buffer, GLsizeiptr size, GLsizeiptr keep)
+	{
+		GLuint resized;
+		glGenBuffers(1, &resized);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+		if (keep > 0)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, keep);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+		return resized;
+	}
+
+	bool FlameCompute::supported()
+	{
+		return GLAD_GL_VERSION_4_3 != 0;
+	}
+
+	FlameCompute::FlameCompute(unsigned int seed)
+	{
+		mCapacity = 0;
+		mReserved = 0;
+		mLauncherCount = 0;
+		mSeed = seed;
+		mFrame = 0;
+		mInstancesDirty = false;
+		// the packed particle layout has to come first, it may enable an extension
+		std::string particle = Shader::readFile("./flame_particle.glsl");
+		std::string random = Shader::readFile("./random.glsl");
+		mSimulateShader = new Shader("./flame_simulate_cs.vs", particle + random);
+		mEmitShader = new Shader("./flame_emit_cs.vs", particle + random);
+		mRenderShader = new Shader("./flame_render_ssbo.vs", "./flame_render_fs.vs", nullptr, particle);
+
+		// empty pool, grow() sizes the per-slot buffers
+		Counters counters = { 0, 1, 0, 0, 0, 0, 0 };
+		glGenBuffers(1, &mParticleBuffer);
+		glGenBuffers(1, &mParticleFlame);
+		glGenBuffers(1, &mInstanceBuffer);
+		glGenBuffers(1, &mDeadList);
+		glGenBuffers(1, &mDrawList);
+		glGenBuffers(1, &mEmitList);
+		glGenBuffers(1, &mCounters);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCounters);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Counters), &counters, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glGenVertexArrays(1, &mEmptyArray);
+	}
+
+	FlameCompute::~FlameCompute()
+	{
+		glDeleteBuffers(1, &mParticleBuffer);
+		glDeleteBuffers(1, &mParticleFlame);
+		glDeleteBuffers(1, &mInstanceBuffer);
+		glDeleteBuffers(1, &mDeadList);
+		glDeleteBuffers(1, &mDrawList);
+		glDeleteBuffers(1, &mEmitList);
+		glDeleteBuffers(1, &mCounters);
+		glDeleteVertexArrays(1, &mEmptyArray);
+		glDeleteProgram(mSimulateShader->ID);
+		glDeleteProgram(mEmitShader->ID);
+		glDeleteProgram(mRenderShader->ID);
+		delete mSimulateShader;
+		delete mEmitShader;
+		delete mRenderShader;
+	}
+
+	GLint FlameCompute::readDeadCount()
+	{
+		GLint deadCount = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCounters);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(Counters, deadCount), sizeof(GLint), &deadCount);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		return deadCount;
+	}
+
+	void FlameCompute::writeDeadCount(GLint deadCount)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCounters);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(Counters, deadCount), sizeof(GLint), &deadCount);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	void FlameCompute::grow(int capacity)
+	{
+		GLint deadCount = readDeadCount();
+		int added = capacity - mCapacity;
+		std::vector<FlameParticle> dead(added, packFlameParticle(PARTICLE_TYPE_DEAD, glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f, 0.0f));
+		std::vector<GLuint> slots(added);
+		for (int i = 0; i < added; i++)
+			slots[i] = mCapacity + i;
+
+		// live particles and the free slots keep their place, the new slots go on the dead list
+		mParticleBuffer = resizeBuffer(mParticleBuffer, capacity * sizeof(FlameParticle), mCapacity * sizeof(FlameParticle));
+		mParticleFlame = resizeBuffer(mParticleFlame, capacity * sizeof(GLuint), mCapacity * sizeof(GLuint));
+		mDeadList = resizeBuffer(mDeadList, capacity * sizeof(GLuint), deadCount * sizeof(GLuint));
+		// rebuilt every frame
+		mDrawList = resizeBuffer(mDrawList, capacity * sizeof(GLuint), 0);
+		mEmitList = resizeBuffer(mEmitList, capacity * sizeof(GLuint), 0);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mParticleBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, mCapacity * sizeof(FlameParticle), added * sizeof(FlameParticle), dead.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDeadList);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, deadCount * sizeof(GLuint), added * sizeof(GLuint), slots.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		writeDeadCount(deadCount + added);
+		mCapacity = capacity;
+	}
+
+	void FlameCompute::writeSlots(const std::vector<GLuint>& slots, const std::vector<FlameParticle>& particles, GLuint flame)
+	{
+		std::vector<GLuint> flames(slots.size(), flame);
+		size_t begin = 0;
+		while (begin < slots.size())
+		{
+			size_t end = begin + 1;
+			while (end < slots.size() && slots[end] == slots[end - 1] + 1)
+				end++;
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, mParticleBuffer);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, slots[begin] * sizeof(FlameParticle), (end - begin) * sizeof(FlameParticle), &particles[begin]);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, mParticleFlame);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, slots[begin] * sizeof(GLuint), (end - begin) * sizeof(GLuint), &flames[begin]);
+			begin = end;
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	int FlameCompute::addFlame(const std::vector<FlameParticle>& launchers, int shells)
+	{
+		PROFILE_SCOPE("FlameCompute::addFlame");
+		int count = (int)launchers.size();
+		if (count == 0)
+			return -1;
+		// the launchers take their slots from the dead list; grow when it is too short or the
+		// pool cannot hold the shells of every flame
+		GLint deadCount = readDeadCount();
+		int needed = mReserved + count + shells;
+		if (needed > mCapacity || deadCount < count)
+		{
+			int capacity = std::max(needed, mCapacity + count - deadCount);
+			grow(std::max(capacity, mCapacity * 2));
+			deadCount = readDeadCount();
+		}
+
+		int flame = 0;
+		while (flame < (int)mFlames.size() && !mFlames[flame].launchers.empty())
+			flame++;
+		// no emission until setFlame gives the flame its velocity range
+		FlameInstance instance = { glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) };
+		if (flame == (int)mFlames.size())
+		{
+			mFlames.push_back(FlameSlots());
+			mInstances.push_back(instance);
+		}
+		FlameSlots& slots = mFlames[flame];
+		slots.launchers.resize(count);
+		slots.shells = shells;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDeadList);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, (deadCount - count) * sizeof(GLuint), count * sizeof(GLuint), slots.launchers.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		writeDeadCount(deadCount - count);
+		std::sort(slots.launchers.begin(), slots.launchers.end());
+		writeSlots(slots.launchers, launchers, flame);
+
+		mInstances[flame] = instance;
+		mInstancesDirty = true;
+		mReserved += count + shells;
+		mLauncherCount += count;
+		return flame;
+	}
+
+	void FlameCompute::removeFlame(int flame)
+	{
+		PROFILE_SCOPE("FlameCompute::removeFlame");
+		if (flame < 0 || flame >= (int)mFlames.size() || mFlames[flame].launchers.empty())
+			return;
+		FlameSlots& slots = mFlames[flame];
+		int count = (int)slots.launchers.size();
+		// the launchers become free slots for the shells of the other flames
+		std::vector<FlameParticle> dead(count, packFlameParticle(PARTICLE_TYPE_DEAD, glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f, 0.0f));
+		writeSlots(slots.launchers, dead, flame);
+		GLint deadCount = readDeadCount();
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDeadList);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, deadCount * sizeof(GLuint), count * sizeof(GLuint), slots.launchers.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		writeDeadCount(deadCount + count);
+
+		mReserved -= count + slots.shells;
+		mLauncherCount -= count;
+		slots.launchers.clear();
+		slots.shells = 0;
+	}
+
+	void FlameCompute::setFlame(int flame, const glm::vec3& origin, const glm::vec3& maxVelocity, const glm::vec3& minVelocity)
+	{
+		if (flame < 0 || flame >= (int)mInstances.size())
+			return;
+		FlameInstance instance = { glm::vec4(origin, 1.0f), glm::vec4(maxVelocity, 0.0f), glm::vec4(minVelocity, 0.0f) };
+		FlameInstance& current = mInstances[flame];
+		if (current.origin == instance.origin && current.maxVelocity == instance.maxVelocity && current.minVelocity == instance.minVelocity)
+			return;
+		current = instance;
+		mInstancesDirty = true;
+	}
+
+	void FlameCompute::update(float deltaTimeMills, float maxLife, float minLife, float centerRadius)
+	{
+		PROFILE_SCOPE("FlameCompute::update");
+		if (mCapacity == 0)
+			return;
+		if (mInstancesDirty)
+		{
+			// a few dozen flames at most, cheaper to send them all than to track changes
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, mInstanceBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, mInstances.size() * sizeof(FlameInstance), mInstances.data(), GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			mInstancesDirty = false;
+		}
+
+		// new frame: empty draw list, no emission requests
+		const GLuint zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCounters);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(Counters, vertexCount), sizeof(GLuint), &zero);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(Counters, emitCount), sizeof(GLuint), &zero);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mParticleBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mDeadList);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mDrawList);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mEmitList);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mCounters);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mInstanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mParticleFlame);
+
+		mSimulateShader->use();
+		mSimulateShader->setFloat("gDeltaTimeMillis", deltaTimeMills);
+		mSimulateShader->setFloat("MAX_LIFE", maxLife);
+		mSimulateShader->setFloat("MIN_LIFE", minLife);
+		mSimulateShader->setInt("capacity", mCapacity);
+		mSimulateShader->setUint("gFrame", mFrame);
+		mSimulateShader->setUint("gSeed", mSeed);
+		glDispatchCompute((mCapacity + 255) / 256, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		if (mLauncherCount > 0)
+		{
+			mEmitShader->use();
+			mEmitShader->setFloat("MAX_LIFE", maxLife);
+			mEmitShader->setFloat("MIN_LIFE", minLife);
+			mEmitShader->setFloat("r", centerRadius);
+			mEmitShader->setUint("gFrame", mFrame);
+			mEmitShader->setUint("gSeed", mSeed);
+			// at most one request per launcher
+			glDispatchCompute((mLauncherCount + 63) / 64, 1, 1);
+		}
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+		mFrame++;
+	}
+
+	void FlameCompute::draw()
+	{
+		if (mCapacity == 0)
+			return;
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mParticleBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mDrawList);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mInstanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mParticleFlame);
+		glBindVertexArray(mEmptyArray);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCounters);
+		glDrawArraysIndirect(GL_POINTS, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef FLAME_COMPUTE_H
+#define FLAME_COMPUTE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Shader.h"
+
+namespace Flame {
+
+	struct FlameParticle;
+
+	// Compute-shader flame simulation (GL 4.3), the replacement for the transform feedback
+	// path. The particles stay in one storage buffer and are updated in place:
+	//   simulate  launchers count down and append an emission request, shells age and move,
+	//             expired shells push their slot onto the dead list
+	//   emit      every request pops a slot from the dead list and starts a shell there
+	// Both passes append the index of every live particle to a draw list, and its length is
+	// the vertex count of the indirect draw command, so rendering is one glDrawArraysIndirect.
+	//
+	// The buffer is a pool shared by any number of flames. Every flame owns its launchers,
+	// which are stored relative to the flame's origin; the shells of all flames share the dead
+	// list and are stored with the origin applied, so they keep their path when a flame moves.
+	// The pool grows when a flame is added that does not fit.
+	class FlameCompute
+	{
+	public:
+		static bool supported();
+
+		// seed picks the random sequences (random.glsl), the same seed gives the same run
+		explicit FlameCompute(unsigned int seed);
+		~FlameCompute();
+
+		// launchers are relative to the flame's origin, shells is the number of slots the flame
+		// adds to the pool for its shells. Returns the index for setFlame and removeFlame.
+		// Reads the dead list back, so it stalls; meant for scene changes, not every frame
+		int addFlame(const std::vector<FlameParticle>& launchers, int shells);
+		// the flame stops emitting, its live shells burn out
+		void removeFlame(int flame);
+		// where the flame's shells start and the range of their initial velocity
+		void setFlame(int flame, const glm::vec3& origin, const glm::vec3& maxVelocity, const glm::vec3& minVelocity);
+
+		// one step for every flame of the pool
+		void update(float deltaTimeMills, float maxLife, float minLife, float centerRadius);
+		// draws the live particles with renderShader(), which the caller has set up
+		void draw();
+		Shader& renderShader() { return *mRenderShader; }
+		int capacity() const { return mCapacity; }
+
+	private:
+		// counters shared by the passes; the first four words are the indirect draw command
+		struct Counters
+		{
+			GLuint vertexCount;   // live particles in the draw list
+			GLuint instanceCount;
+			GLuint first;
+			GLuint baseInstance;
+			GLint deadCount;      // entries on the dead list
+			GLuint emitCount;     // emission requests of this frame
+			GLuint overflow;      // requests dropped because the dead list was empty
+		};
+
+		// per flame, std430 layout of FlameInstance in the shaders
+		struct FlameInstance
+		{
+			glm::vec4 origin;
+			glm::vec4 maxVelocity;
+			glm::vec4 minVelocity;
+		};
+
+		// CPU bookkeeping of a flame; no launchers means the index is free
+		struct FlameSlots
+		{
+			std::vector<GLuint> launchers;
+			int shells;
+		};
+
+		int mCapacity;
+		int mReserved;      // slots the flames asked for, launchers and shells
+		int mLauncherCount; // launchers of all flames
+		unsigned int mSeed;
+		unsigned int mFrame;
+		std::vector<FlameInstance> mInstances;
+		std::vector<FlameSlots> mFlames;
+		bool mInstancesDirty;
+		GLuint mParticleBuffer;
+		GLuint mParticleFlame; // flame index of every slot, used for launchers
+		GLuint mInstanceBuffer;
+		GLuint mDeadList;
+		GLuint mDrawList;
+		GLuint mEmitList;
+		GLuint mCounters;
+		GLuint mEmptyArray; // core profile draws need a VAO, the vertex shader reads the buffers
+		Shader* mSimulateShader;
+		Shader* mEmitShader;
+		Shader* mRenderShader;
+
+		// adds slots to the pool, all of them dead
+		void grow(int capacity);
+		GLint readDeadCount();
+		void writeDeadCount(GLint deadCount);
+		// writes particles to the given slots (sorted), one upload per contiguous run
+		void writeSlots(const std::vector<GLuint>& slots, const std::vector<FlameParticle>& particles, GLuint flame);
+
+		FlameCompute(const FlameCompute&) = delete;
+		FlameCompute& operator=(const FlameCompute&) = delete;
+	};
+
+}
+
+#endif // FLAME_COMPUTE_H
@@ -0,0 +1,94 @@
+#include "FlameManager.h"
+#include "CpuProfiler.h"
+#include "TextureCache.h"
+
+namespace Flame {
+
+	FlameManager::FlameManager(unsigned int seed)
+	{
+		mCount = 0;
+		mAdded = 0;
+		mSeed = seed;
+		mCompute = new FlameCompute(seed);
+		mSparkTexture = TextureCache::instance().load("texture/particle.bmp");
+		mStartTexture = TextureCache::instance().load("texture/flame.bmp");
+		mCompute->renderShader().use();
+		mCompute->renderShader().setInt("flameSpark", 0);
+		mCompute->renderShader().setInt("flameStart", 1);
+	}
+
+	FlameManager::~FlameManager()
+	{
+		delete mCompute;
+	}
+
+	int FlameManager::add(const glm::vec3& position, const glm::vec3& velocity, int particles)
+	{
+		FlameState state;
+		state.position = position;
+		state.burning = true;
+		velocityRange(velocity, state.maxVelocity, state.minVelocity);
+
+		// same share of launchers as a single Flame; every flame gets its own launcher layout
+		int launchers = (int)((long long)particles * INIT_PARTICLES / MAX_PARTICLES);
+		std::vector<FlameParticle> initial(launchers);
+		genLaunchers(initial.data(), launchers, state.maxVelocity, state.minVelocity, mSeed + mAdded++);
+		int flame = mCompute->addFlame(initial, particles - launchers);
+		if (flame < 0)
+			return -1;
+		if (flame >= (int)mFlames.size())
+			mFlames.resize(flame + 1);
+		mFlames[flame] = state;
+		mCompute->setFlame(flame, state.position, state.maxVelocity, state.minVelocity);
+		mCount++;
+		return flame;
+	}
+
+	void FlameManager::remove(int flame)
+	{
+		if (flame < 0 || flame >= (int)mFlames.size() || !mFlames[flame].burning)
+			return;
+		mCompute->removeFlame(flame);
+		mFlames[flame].burning = false;
+		mCount--;
+	}
+
+	void FlameManager::setPosition(int flame, const glm::vec3& position)
+	{
+		if (flame < 0 || flame >= (int)mFlames.size())
+			return;
+		FlameState& state = mFlames[flame];
+		state.position = position;
+		mCompute->setFlame(flame, state.position, state.maxVelocity, state.minVelocity);
+	}
+
+	void FlameManager::Update(float deltaTime)
+	{
+		PROFILE_SCOPE("FlameManager::Update");
+		mCompute->update(deltaTime * 1000.0f, MAX_LIFE, MIN_LIFE, r);
+	}
+
+	void FlameManager::Render(glm::mat4 viewMatrix, glm::mat4& projectMatrix)
+	{
+		PROFILE_SCOPE("FlameManager::Render");
+		glEnable(GL_PROGRAM_POINT_SIZE);
+		glDepthMask(GL_FALSE);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+		// particles are stored in world space (launchers relative to their flame's origin)
+		Shader& shader = mCompute->renderShader();
+		shader.use();
+		shader.setMat4("model", glm::mat4(1.0f));
+		shader.setMat4("view", viewMatrix);
+		shader.setMat4("projection", projectMatrix);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, mSparkTexture);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, mStartTexture);
+		mCompute->draw();
+		glActiveTexture(GL_TEXTURE0);
+		glDisable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+	}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef FLAME_MANAGER_H
+#define FLAME_MANAGER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Flame.h"
+#include "FlameCompute.h"
+
+namespace Flame {
+
+	// Any number of flames served from one FlameCompute pool: the shaders and textures exist
+	// once, every flame is updated by the same two dispatches and all of them are drawn with a
+	// single indirect draw, so dozens of fires cost little more than one. The pool grows when
+	// a flame is added that does not fit. Needs GL 4.3 like FlameCompute.
+	class FlameManager
+	{
+	public:
+		static bool supported() { return FlameCompute::supported(); }
+
+		explicit FlameManager(unsigned int seed = 1);
+		~FlameManager();
+
+		// a flame burning at position. velocity works like Flame::velocity (the particles go the
+		// other way), particles is what the flame adds to the pool, launchers included.
+		// Returns the handle for setPosition and remove
+		int add(const glm::vec3& position, const glm::vec3& velocity = glm::vec3(0.5f, 0.4f, 0.0f),
+			int particles = MAX_PARTICLES);
+		// the flame stops emitting, its last particles burn out
+		void remove(int flame);
+		// new particles start here, the ones already emitted keep their path
+		void setPosition(int flame, const glm::vec3& position);
+
+		// advances every flame by deltaTime seconds
+		void Update(float deltaTime);
+		// draws every flame into the current framebuffer; depth tested against the scene, but
+		// the additive particles do not write depth
+		void Render(glm::mat4 viewMatrix, glm::mat4& projectMatrix);
+
+		int size() const { return mCount; }
+		int capacity() const { return mCompute->capacity(); }
+
+	private:
+		struct FlameState
+		{
+			glm::vec3 position;
+			glm::vec3 maxVelocity;
+			glm::vec3 minVelocity;
+			bool burning;
+		};
+
+		FlameCompute* mCompute;
+		std::vector<FlameState> mFlames; // indexed by the FlameCompute flame index
+		int mCount;
+		unsigned int mAdded; // flames added so far, picks the launcher layout of the next one
+		unsigned int mSeed;
+		unsigned int mSparkTexture;
+		unsigned int mStartTexture;
+
+		FlameManager(const FlameManager&) = delete;
+		FlameManager& operator=(const FlameManager&) = delete;
+	};
+
+}
+
+#endif // FLAME_MANAGER_H
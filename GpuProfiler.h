@@ -0,0 +1,210 @@
+#pragma once
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Per-pass GPU timing built on GL_TIME_ELAPSED queries. Every pass owns two queries that
+// alternate between frames; a result is only read once the driver reports it available,
+// so the profiler never waits on the GPU. A sample that is not ready by the time its query
+// is reused is dropped.
+// Passes must not nest: only one GL_TIME_ELAPSED query can be active at a time.
+// A pass can also count the primitives that reach the clipper (GL 4.6 pipeline statistics),
+// which is the rasterised work of a geometry shader that amplifies or of per-face culling.
+// Only the rolling averages are kept unless history recording is on for writeCSV.
+class GpuProfiler {
+public:
+    static const int AVERAGE_WINDOW = 120; // frames in the rolling average
+
+    // keep every sample for writeCSV; off by default, the history grows with every frame
+    void setRecordHistory(bool record) {
+        recordHistory = record;
+    }
+
+    void beginPass(const std::string& name, bool countPrimitives = false) {
+        Pass& pass = getPass(name);
+        int slot = frame & 1;
+        if (pass.pending[slot])
+            collect(pass, slot);
+        pass.pending[slot] = false;
+        glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+        pass.counted[slot] = countPrimitives && GLAD_GL_VERSION_4_6;
+        if (pass.counted[slot]) {
+            if (!pass.primitiveQueries[0])
+                glGenQueries(2, pass.primitiveQueries);
+            glBeginQuery(GL_CLIPPING_INPUT_PRIMITIVES, pass.primitiveQueries[slot]);
+        }
+        pass.issuedFrame[slot] = frame;
+        activePass = &pass;
+    }
+
+    void endPass() {
+        if (!activePass)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        if (activePass->counted[frame & 1])
+            glEndQuery(GL_CLIPPING_INPUT_PRIMITIVES);
+        activePass->pending[frame & 1] = true;
+        activePass = nullptr;
+    }
+
+    // call once per frame after the last pass; picks up whatever the previous frame produced
+    void endFrame() {
+        int previous = (frame + 1) & 1;
+        for (Pass& pass : passes) {
+            if (pass.pending[previous])
+                collect(pass, previous);
+        }
+        frame++;
+    }
+
+    // drops the rolling averages, e.g. when a benchmark switches configuration; the history
+    // written by writeCSV is kept
+    void resetAverages() {
+        for (Pass& pass : passes) {
+            pass.time = Rolling();
+            pass.primitives = Rolling();
+        }
+    }
+
+    // rolling average over the last AVERAGE_WINDOW samples, in milliseconds
+    double average(const std::string& name) const {
+        auto it = passIndex.find(name);
+        if (it == passIndex.end())
+            return 0.0;
+        return passes[it->second].time.average();
+    }
+
+    // rolling average of the primitives counted per frame, 0 if the pass never counted
+    double primitives(const std::string& name) const {
+        auto it = passIndex.find(name);
+        if (it == passIndex.end())
+            return 0.0;
+        return passes[it->second].primitives.average();
+    }
+
+    void report(std::ostream& out) const {
+        out << "GPU passes (avg of last " << AVERAGE_WINDOW << " frames):" << std::endl;
+        for (const Pass& pass : passes) {
+            out << "  " << pass.name << ": " << average(pass.name) << " ms";
+            if (!pass.primitives.empty())
+                out << ", " << (long long)primitives(pass.name) << " primitives";
+            out << std::endl;
+        }
+    }
+
+    // one row per sample collected while history recording was on: frame index, pass name,
+    // GPU milliseconds
+    void writeCSV(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file) {
+            std::cout << "Failed to open GPU profile csv: " << path << std::endl;
+            return;
+        }
+        file << "frame,pass,gpu_ms,primitives\n";
+        for (const Pass& pass : passes) {
+            for (const Sample& sample : pass.history) {
+                file << sample.frame << "," << pass.name << "," << sample.ms << ",";
+                if (sample.primitives >= 0)
+                    file << sample.primitives;
+                file << "\n";
+            }
+        }
+    }
+
+private:
+    struct Sample {
+        int frame;
+        double ms;
+        long long primitives; // -1 when not counted
+    };
+
+    // average of the last AVERAGE_WINDOW values
+    struct Rolling {
+        std::vector<double> window;
+        int pos = 0;
+        double sum = 0.0;
+
+        void add(double value) {
+            if ((int)window.size() < AVERAGE_WINDOW) {
+                window.push_back(value);
+            }
+            else {
+                sum -= window[pos];
+                window[pos] = value;
+                pos = (pos + 1) % AVERAGE_WINDOW;
+            }
+            sum += value;
+        }
+
+        bool empty() const {
+            return window.empty();
+        }
+
+        double average() const {
+            return window.empty() ? 0.0 : sum / window.size();
+        }
+    };
+
+    struct Pass {
+        std::string name;
+        unsigned int queries[2] = { 0, 0 };
+        unsigned int primitiveQueries[2] = { 0, 0 };
+        bool pending[2] = { false, false };
+        bool counted[2] = { false, false };
+        int issuedFrame[2] = { 0, 0 };
+        Rolling time;
+        Rolling primitives;
+        std::vector<Sample> history;
+    };
+
+    std::vector<Pass> passes;
+    std::map<std::string, size_t> passIndex;
+    Pass* activePass = nullptr;
+    int frame = 0;
+    bool recordHistory = false;
+
+    Pass& getPass(const std::string& name) {
+        auto it = passIndex.find(name);
+        if (it != passIndex.end())
+            return passes[it->second];
+        passIndex[name] = passes.size();
+        passes.push_back(Pass());
+        Pass& pass = passes.back();
+        pass.name = name;
+        glGenQueries(2, pass.queries);
+        return pass;
+    }
+
+    void collect(Pass& pass, int slot) {
+        GLint available = 0;
+        glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available && pass.counted[slot])
+            glGetQueryObjectiv(pass.primitiveQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &elapsed);
+        long long primitiveCount = -1;
+        if (pass.counted[slot]) {
+            GLuint64 count = 0;
+            glGetQueryObjectui64v(pass.primitiveQueries[slot], GL_QUERY_RESULT, &count);
+            primitiveCount = (long long)count;
+            pass.primitives.add((double)count);
+        }
+        pass.pending[slot] = false;
+
+        double ms = elapsed / 1.0e6;
+        pass.time.add(ms);
+        if (recordHistory)
+            pass.history.push_back({ pass.issuedFrame[slot], ms, primitiveCount });
+    }
+};
+
+#endif // GPU_PROFILER_H
@@ -9,43 +9,47 @@
 #include <vector>
 
 
+// Light fixture: a lower hemisphere of the given radius around position. The hemisphere is
+// built once into immutable storage shared by all lights; LightBatch draws many lights with
+// one instanced call.
 class Light {
 public:
     glm::vec3 position;
     float radius;
-    unsigned int VBO;
-    unsigned int VAO;
-    unsigned int EBO;
-    const int Y_SEGMENTS = 50;
-    const int X_SEGMENTS = 50;
+    static const int Y_SEGMENTS = 50;
+    static const int X_SEGMENTS = 50;
 
     // Constructor to initialize bullet parameters
     Light(glm::vec3 pos, float rad)
         : position(pos), radius(rad) {
-        // Ķ
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * 360, nullptr, GL_DYNAMIC_DRAW);
+        // make sure the shared hemisphere exists before the first frame
+        unitHemisphere();
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    float getRadius() {
+        return radius;
+    }
 
-        // λ
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+    glm::vec3 getPosition() {
+        return position;
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+private:
+    friend class LightBatch;
 
-        glBindVertexArray(0);
-    }
+    struct HemisphereMesh {
+        unsigned int VAO = 0;
+        unsigned int VBO = 0;
+        unsigned int EBO = 0;
+        unsigned int indexCount = 0;
+    };
 
+    // lower hemisphere of a unit sphere at the origin, built on first use
+    static const HemisphereMesh& unitHemisphere() {
+        static HemisphereMesh mesh;
+        if (mesh.VAO != 0)
+            return mesh;
 
-    void draw() {
-        // Update vertex data for the lower hemisphere
         std::vector<glm::vec3> vertices;
         std::vector<unsigned int> indices;
 
@@ -63,7 +67,7 @@ public:
                 float y = cosTheta;
                 float z = sinPhi * sinTheta;
 
-                vertices.push_back(glm::vec3(position.x + radius * x, position.y + radius * y, position.z + radius * z));
+                vertices.push_back(glm::vec3(x, y, z));
             }
         }
 
@@ -84,31 +88,84 @@ public:
             }
         }
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_DYNAMIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
+        glGenVertexArrays(1, &mesh.VAO);
+        glGenBuffers(1, &mesh.VBO);
+        glGenBuffers(1, &mesh.EBO);
+
+        glBindVertexArray(mesh.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        // immutable storage where available (GL 4.4), the data never changes after this
+        if (GLAD_GL_VERSION_4_4) {
+            glBufferStorage(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], 0);
+            glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], 0);
+        }
+        else {
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        }
 
-        // Draw the lower hemisphere as solid and set the color to white
-        glBindVertexArray(VAO);
+        // λ
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
-
-        // Draw the hemisphere
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-        // Clean up
         glBindVertexArray(0);
-    }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+        mesh.indexCount = (unsigned int)indices.size();
+        return mesh;
+    }
+};
 
-    float getRadius() {
-        return radius;
+// Lights drawn with one instanced call. Center and radius of every light are written into a
+// per-instance attribute buffer when the batch is built, so drawing only binds the VAO.
+class LightBatch {
+public:
+    LightBatch() : VAO(0), instanceVBO(0), count(0) {}
+
+    // needs a current GL context; build again after lights are added or moved
+    void build(const std::vector<Light>& lights) {
+        std::vector<glm::vec4> instances;
+        for (const Light& light : lights)
+            instances.push_back(glm::vec4(light.position, light.radius));
+        count = (unsigned int)instances.size();
+
+        if (VAO == 0) {
+            const Light::HemisphereMesh& mesh = Light::unitHemisphere();
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &instanceVBO);
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+            // xyz center, w radius
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribDivisor(1, 1);
+            glBindVertexArray(0);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), instances.empty() ? NULL : &instances[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    glm::vec3 getPosition() {
-        return position;
+    // draws all lights with the light shader in use
+    void draw() const {
+        if (count == 0)
+            return;
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, Light::unitHemisphere().indexCount, GL_UNSIGNED_INT, 0, count);
+        glBindVertexArray(0);
     }
+
+private:
+    unsigned int VAO;
+    unsigned int instanceVBO;
+    unsigned int count;
+
+    LightBatch(const LightBatch&) = delete;
+    LightBatch& operator=(const LightBatch&) = delete;
 };
 
 #endif // BULLET_H
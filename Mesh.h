@@ -58,7 +58,7 @@ public:
     }
 
     // render the mesh
-    void Draw(Shader& shader)
+    void Draw(Shader& shader) const
     {
         // bind appropriate textures
         unsigned int diffuseNr = 1;
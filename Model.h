@@ -12,13 +12,17 @@
 #include <assimp/postprocess.h>
 
 #include "Mesh.h"
+#include "TriangleBVH.h"
 #include "Shader.h"
+#include "CpuProfiler.h"
+#include "TextureCache.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
@@ -28,7 +32,10 @@ extern const int roomDepth = 20.0f;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
-class Model
+// Everything loaded from a model file: GPU meshes, textures, the model-space bounding box and
+// the collision BVH. It is immutable once loaded and shared by every Model placed from the
+// same file; get it through ModelAsset::load, which imports each path only once.
+class ModelAsset
 {
 public:
     // model data 
@@ -36,189 +43,34 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
-    glm::vec3 scale;        // scale factor (scaling in x, y, z)
-    glm::vec3 offset;       // offset (translation in x, y, z)
-    glm::mat4 rotation;
     glm::vec3 bboxMin = glm::vec3(FLT_MAX);
     glm::vec3 bboxMax = glm::vec3(FLT_MIN);
-    glm::vec3 transformedMin;
-    glm::vec3 transformedMax;
-    glm::vec3 direction;
-    const float massCenter = 0.05f;
-    unsigned int textureID;
-    
-
-    // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false, glm::vec3 scale = glm::vec3(1.0f), glm::vec3 offset = glm::vec3(0.0f))
-        : gammaCorrection(gamma), scale(scale), offset(offset)
-    {
-        loadModel(path);
-        direction = glm::vec3(0.0f, 0.0f, 1.0f);
+    TriangleBVH bvh;                // model-space triangles, built once at load
+
+    // shared asset for path, imported on the first request
+    static std::shared_ptr<const ModelAsset> load(string const& path, bool gamma = false) {
+        static std::map<string, std::shared_ptr<const ModelAsset> > registry;
+        string key = gamma ? path + "#gamma" : path;
+        auto it = registry.find(key);
+        if (it != registry.end())
+            return it->second;
+        std::shared_ptr<const ModelAsset> asset(new ModelAsset(path, gamma));
+        registry[key] = asset;
+        return asset;
     }
 
-    // Update the wobbling effect of the object around the Z-axis
-    void updateWobbling(float deltaTime) {
-
-        // Calculate angular acceleration based on the differential equation
-        // d^2(theta)/dt^2 + b*d(theta)/dt + k*theta = 0
-        // Neglecting mass (m) as it cancels out during the equation derivation for a pendulum
-        alpha = (-k * theta - b * omega) / I;
-
-        // Update angular velocity and angle using Euler's method
-        omega += alpha * deltaTime;
-        theta += omega * deltaTime;
-
-        // If the angular velocity is close to zero and the object is at the bottom (theta ~ 0)
-        // we assume it has stopped wobbling due to damping
-        if (abs(omega) < 0.01 && abs(theta) < 0.01) {
-            omega = 0.0f;
-            theta = 0.0f;
-            isWobbling = false; // The wobbling has stopped
-        }
-
-        rotation = glm::rotate(glm::mat4(1.0f), theta, direction); // Rotate around Z-axis
-        updateTransformedBoundingBox();
-    }
-
-    void Draw(Shader& shader)
-    {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, offset);  // apply translation (offset)
-        model = glm::scale(model, scale);       // apply scaling
-        // Combine the transformation
-        model = model * rotation; // No need for an additional translation in this case
-
-        // set the model matrix in the shader
-        shader.setMat4("model", model);
-        shader.setInt("reverse_normals", 0);
-        // glm::vec4 pos = model * glm::vec4(0.037514f, 0.021025f, 0.024657f, 0.0f);
-        // std::cout << "Draw point" << pos.x << " " << pos.y << " " << pos.z << std::endl;
+    void Draw(Shader& shader) const {
         for (unsigned int i = 0; i < meshes.size(); i++) {
-            // Draw the mesh with the applied model matrix
             meshes[i].Draw(shader);
         }
     }
 
-    bool isSphereBoundingBoxIntersectingAABB(const glm::vec3& sphereCenter, float sphereRadius) {
-        // İΧ
-        glm::vec3 sphereBBoxMin = sphereCenter - glm::vec3(sphereRadius);
-        glm::vec3 sphereBBoxMax = sphereCenter + glm::vec3(sphereRadius);
-
-        // std::cout << "СΧ(min)" << sphereBBoxMin.x << " " << sphereBBoxMin.y << " " << sphereBBoxMin.z << std::endl;
-        // std::cout << "СΧ(max)" << sphereBBoxMax.x << " " << sphereBBoxMax.y << " " << sphereBBoxMax.z << std::endl;
-        // std::cout << "Χ(min)" << transformedMin.x << " " << transformedMin.y << " " << transformedMin.z << std::endl;
-        // std::cout << "Χ(max)" << transformedMax.x << " " << transformedMax.y << " " << transformedMax.z << std::endl;
-
-        // İΧǷ任İΧཻ
-        return (sphereBBoxMin.x <= transformedMax.x && sphereBBoxMax.x >= transformedMin.x) &&
-            (sphereBBoxMin.y <= transformedMax.y && sphereBBoxMax.y >= transformedMin.y) &&
-            (sphereBBoxMin.z <= transformedMax.z && sphereBBoxMax.z >= transformedMin.z);
-    }
-
-    glm::vec3 transformPoint(const glm::vec3& point) {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, offset);  // apply translation (offset)
-        model = glm::scale(model, scale);       // apply scaling
-        model = model * glm::rotate(glm::mat4(1.0f), theta, direction); // No need for an additional translation in this case
-
-
-        glm::vec4 transformedPoint = model * glm::vec4(point, 1.0f); // 任
-        return glm::vec3(transformedPoint); // תvec3
-        // return point;
-    }
-
-    void transformPoint_2(glm::vec3& point) {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, offset);  // apply translation (offset)
-        model = glm::scale(model, scale);       // apply scaling
-        model = model * glm::rotate(glm::mat4(1.0f), theta, direction); // No need for an additional translation in this case
-
-        point = glm::vec3(model * glm::vec4(point, 1.0f)); // 任
-    }
-
-    glm::vec3 getPointVelocity(const glm::vec3& point) {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, offset);  // apply translation (offset)
-        model = glm::scale(model, scale);       // apply scaling
-        // Combine the transformation
-        model = model * glm::rotate(glm::mat4(1.0f), theta, direction); // No need for an additional translation in this case
-
-        glm::vec3 transformedMassCenter = glm::vec3(model * glm::vec4(0.0f, massCenter, 0.0f, 1.0f)); // 任
-
-        return cross(omega * direction, point - transformedMassCenter);
-    }
-
-    void setAngularSpeed(const glm::vec3 & speed, const glm::vec3& point, const glm::vec3& norm) {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, offset);  // apply translation (offset)
-        model = glm::scale(model, scale);       // apply scaling
-        // Combine the transformation
-        model = model * glm::rotate(glm::mat4(1.0f), theta, direction); // No need for an additional translation in this case
-
-        glm::vec3 transformedMassCenter = glm::vec3(model * glm::vec4(0.0f, massCenter, 0.0f, 1.0f)); // 任
-
-        glm::vec3 arm = point - transformedMassCenter;
-        arm = arm - dot(arm, direction) * direction;
-        this->omega = glm::length(speed) / glm::length(arm);
-        this->direction = normalize(glm::vec3(norm.x, 0.0f, norm.z));
-    }
-
-    unsigned int getTexture() const {
-        return textures_loaded[0].id;
-    }
-
-    void move(glm::vec3 &newMousePoint, glm::vec3 &lastMousePoint) {
-        std::cout << "move" << std::endl;
-        glm::vec3 displacement = newMousePoint - lastMousePoint;
-        if (transformedMin.x + displacement.x < -roomWidth / 2.0f ||
-            transformedMax.x + displacement.x > roomWidth / 2.0f ||
-            transformedMin.z + displacement.z < -roomDepth / 2.0f ||
-            transformedMax.z + displacement.z > roomDepth / 2.0f || 
-            transformedMin.y + displacement.y < -roomHeight / 2.0f ||
-            transformedMax.y + displacement.y > roomHeight / 2.0f ) {
-            return;
-        }
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, offset);  // apply translation (offset)
-        model = glm::scale(model, scale);       // apply scaling
-        // Combine the transformation
-        model = model * glm::rotate(glm::mat4(1.0f), theta, direction); // No need for an additional translation in this case
-
-        glm::vec3 transformedMassCenter = glm::vec3(model * glm::vec4(0.0f, massCenter, 0.0f, 1.0f)); // 任
-
-        if (newMousePoint.y < transformedMassCenter.y) {
-            std::cout << "trans" << std::endl;
-            offset.x += displacement.x;
-            offset.z += displacement.z;
-        }
-        else {
-            std::cout << "ת " << std::endl;          
-            this->direction = normalize(cross(glm::vec3(0.0f, 1.0f, 0.0f),glm::vec3(displacement.x, 0.0f, displacement.z)));
-            glm::vec3 arm = newMousePoint - transformedMassCenter;
-            // arm = arm - dot(arm, direction) * direction;
-            // displacement = displacement - dot(displacement, direction) * direction;
-            // displacement = displacement - dot(displacement, arm) * arm / glm::length(arm);
-            std::cout << glm::length(displacement) << " " << glm::length(arm) << " ";
-            float theta_del;
-            if (glm::length(arm) > 0)
-                theta_del = glm::length(displacement) / (glm::length(arm) + 2.0f);
-            else  theta_del = glm::length(displacement) / 5.0f;
-            std::cout << theta_del;
-            theta += theta_del;
-        }
-        updateTransformedBoundingBox();
-    }
-
 private:
-    // Wobbling properties
-    float theta = 0.0f; // Current angle of wobble (in radians)
-    float omega = 0.0f; // Current angular velocity (in radians per second)
-    float b = 0.05f;     // Damping coefficient
-    float k = 2.0f;     // Spring constant for restoring torque
-    float I = 0.5f;     // Moment of inertia
-    // float deltaTime = 0.016f; // Time step for the simulation (1/60 seconds for 60FPS)
-    bool isWobbling = true;
-    float alpha;
+    ModelAsset(string const& path, bool gamma)
+        : gammaCorrection(gamma)
+    {
+        loadModel(path);
+    }
 
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
@@ -245,7 +97,7 @@ private:
                 updateBoundingBox(point);
             }
         }
-        updateTransformedBoundingBox();
+        bvh.build(meshes);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -395,10 +247,200 @@ private:
         bboxMax.y = std::max(bboxMax.y, point.y);
         bboxMax.z = std::max(bboxMax.z, point.z);
     }
+};
+
+// One placed copy of a model: offset, scale and wobble state on top of a shared ModelAsset.
+class Model
+{
+public:
+    std::shared_ptr<const ModelAsset> asset;
+    glm::vec3 scale;        // scale factor (scaling in x, y, z)
+    glm::vec3 offset;       // offset (translation in x, y, z)
+    glm::vec3 transformedMin;
+    glm::vec3 transformedMax;
+    glm::vec3 direction;
+    const float massCenter = 0.05f;
+    glm::mat4 modelMatrix;          // translate * scale * rotate, refreshed whenever the transform changes
+    glm::mat4 inverseModelMatrix;
+    
+
+    // constructor, expects a filepath to a 3D model. The file is only imported for the first Model using it.
+    Model(string const& path, bool gamma = false, glm::vec3 scale = glm::vec3(1.0f), glm::vec3 offset = glm::vec3(0.0f))
+        : asset(ModelAsset::load(path, gamma)), scale(scale), offset(offset)
+    {
+        direction = glm::vec3(0.0f, 0.0f, 1.0f);
+        updateTransformedBoundingBox();
+    }
+
+    // Update the wobbling effect of the object around the Z-axis
+    void updateWobbling(float deltaTime) {
+        PROFILE_SCOPE("Model::updateWobbling");
+        previousTheta = theta;
+
+        // Calculate angular acceleration based on the differential equation
+        // d^2(theta)/dt^2 + b*d(theta)/dt + k*theta = 0
+        // Neglecting mass (m) as it cancels out during the equation derivation for a pendulum
+        alpha = (-k * theta - b * omega) / I;
+
+        // Update angular velocity and angle using Euler's method
+        omega += alpha * deltaTime;
+        theta += omega * deltaTime;
+
+        // If the angular velocity is close to zero and the object is at the bottom (theta ~ 0)
+        // we assume it has stopped wobbling due to damping
+        if (abs(omega) < 0.01 && abs(theta) < 0.01) {
+            omega = 0.0f;
+            theta = 0.0f;
+            isWobbling = false; // The wobbling has stopped
+        }
+
+        updateTransformedBoundingBox();
+    }
+
+    // model matrix Draw uses; alpha blends the wobble angle between the previous and the current physics step
+    glm::mat4 drawMatrix(float alpha = 1.0f) const
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, offset);  // apply translation (offset)
+        model = glm::scale(model, scale);       // apply scaling
+        // Combine the transformation
+        return model * glm::rotate(glm::mat4(1.0f), glm::mix(previousTheta, theta, alpha), direction); // No need for an additional translation in this case
+    }
+
+    void Draw(Shader& shader, float alpha = 1.0f)
+    {
+        // set the model matrix in the shader
+        shader.setMat4("model", drawMatrix(alpha));
+        shader.setInt("reverse_normals", 0);
+        // glm::vec4 pos = model * glm::vec4(0.037514f, 0.021025f, 0.024657f, 0.0f);
+        // std::cout << "Draw point" << pos.x << " " << pos.y << " " << pos.z << std::endl;
+        // Draw the meshes with the applied model matrix
+        asset->Draw(shader);
+    }
+
+    bool isSphereBoundingBoxIntersectingAABB(const glm::vec3& sphereCenter, float sphereRadius) {
+        // İΧ
+        glm::vec3 sphereBBoxMin = sphereCenter - glm::vec3(sphereRadius);
+        glm::vec3 sphereBBoxMax = sphereCenter + glm::vec3(sphereRadius);
+
+        // std::cout << "СΧ(min)" << sphereBBoxMin.x << " " << sphereBBoxMin.y << " " << sphereBBoxMin.z << std::endl;
+        // std::cout << "СΧ(max)" << sphereBBoxMax.x << " " << sphereBBoxMax.y << " " << sphereBBoxMax.z << std::endl;
+        // std::cout << "Χ(min)" << transformedMin.x << " " << transformedMin.y << " " << transformedMin.z << std::endl;
+        // std::cout << "Χ(max)" << transformedMax.x << " " << transformedMax.y << " " << transformedMax.z << std::endl;
+
+        // İΧǷ任İΧཻ
+        return (sphereBBoxMin.x <= transformedMax.x && sphereBBoxMax.x >= transformedMin.x) &&
+            (sphereBBoxMin.y <= transformedMax.y && sphereBBoxMax.y >= transformedMin.y) &&
+            (sphereBBoxMin.z <= transformedMax.z && sphereBBoxMax.z >= transformedMin.z);
+    }
+
+    glm::vec3 transformPoint(const glm::vec3& point) const {
+        glm::vec4 transformedPoint = modelMatrix * glm::vec4(point, 1.0f); // 任
+        return glm::vec3(transformedPoint); // תvec3
+    }
+
+    void transformPoint_2(glm::vec3& point) const {
+        point = glm::vec3(modelMatrix * glm::vec4(point, 1.0f)); // 任
+    }
 
+    // world space -> model space, with the cached inverse
+    glm::vec3 toLocal(const glm::vec3& point) const {
+        return glm::vec3(inverseModelMatrix * glm::vec4(point, 1.0f));
+    }
+
+    // indices of the triangles (see TriangleBVH::triangle) that may touch a sphere given in
+    // world space; the radius is grown by the smallest scale factor so the query stays conservative
+    void queryTriangles(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const {
+        float minScale = std::min(std::abs(scale.x), std::min(std::abs(scale.y), std::abs(scale.z)));
+        asset->bvh.query(toLocal(center), radius / minScale, result);
+    }
+
+    glm::vec3 getPointVelocity(const glm::vec3& point) {
+        glm::vec3 transformedMassCenter = transformPoint(glm::vec3(0.0f, massCenter, 0.0f)); // 任
+
+        return cross(omega * direction, point - transformedMassCenter);
+    }
+
+    void setAngularSpeed(const glm::vec3 & speed, const glm::vec3& point, const glm::vec3& norm) {
+        glm::vec3 transformedMassCenter = transformPoint(glm::vec3(0.0f, massCenter, 0.0f)); // 任
+
+        glm::vec3 arm = point - transformedMassCenter;
+        arm = arm - dot(arm, direction) * direction;
+        this->omega = glm::length(speed) / glm::length(arm);
+        this->direction = normalize(glm::vec3(norm.x, 0.0f, norm.z));
+        updateTransform();
+    }
+
+    // not wobbling and not between two angles: drawn with modelMatrix until something moves it
+    bool isAtRest() const {
+        return theta == 0.0f && previousTheta == 0.0f && omega == 0.0f;
+    }
+
+    unsigned int getTexture() const {
+        return asset->textures_loaded[0].id;
+    }
+
+    void move(glm::vec3 &newMousePoint, glm::vec3 &lastMousePoint) {
+        std::cout << "move" << std::endl;
+        glm::vec3 displacement = newMousePoint - lastMousePoint;
+        if (transformedMin.x + displacement.x < -roomWidth / 2.0f ||
+            transformedMax.x + displacement.x > roomWidth / 2.0f ||
+            transformedMin.z + displacement.z < -roomDepth / 2.0f ||
+            transformedMax.z + displacement.z > roomDepth / 2.0f || 
+            transformedMin.y + displacement.y < -roomHeight / 2.0f ||
+            transformedMax.y + displacement.y > roomHeight / 2.0f ) {
+            return;
+        }
+        glm::vec3 transformedMassCenter = transformPoint(glm::vec3(0.0f, massCenter, 0.0f)); // 任
+
+        if (newMousePoint.y < transformedMassCenter.y) {
+            std::cout << "trans" << std::endl;
+            offset.x += displacement.x;
+            offset.z += displacement.z;
+        }
+        else {
+            std::cout << "ת " << std::endl;          
+            this->direction = normalize(cross(glm::vec3(0.0f, 1.0f, 0.0f),glm::vec3(displacement.x, 0.0f, displacement.z)));
+            glm::vec3 arm = newMousePoint - transformedMassCenter;
+            // arm = arm - dot(arm, direction) * direction;
+            // displacement = displacement - dot(displacement, direction) * direction;
+            // displacement = displacement - dot(displacement, arm) * arm / glm::length(arm);
+            std::cout << glm::length(displacement) << " " << glm::length(arm) << " ";
+            float theta_del;
+            if (glm::length(arm) > 0)
+                theta_del = glm::length(displacement) / (glm::length(arm) + 2.0f);
+            else  theta_del = glm::length(displacement) / 5.0f;
+            std::cout << theta_del;
+            theta += theta_del;
+        }
+        updateTransformedBoundingBox();
+    }
+
+private:
+    // Wobbling properties
+    float theta = 0.0f; // Current angle of wobble (in radians)
+    float previousTheta = 0.0f; // Angle before the last physics step, for render interpolation
+    float omega = 0.0f; // Current angular velocity (in radians per second)
+    float b = 0.05f;     // Damping coefficient
+    float k = 2.0f;     // Spring constant for restoring torque
+    float I = 0.5f;     // Moment of inertia
+    // float deltaTime = 0.016f; // Time step for the simulation (1/60 seconds for 60FPS)
+    bool isWobbling = true;
+    float alpha;
+
+    void updateTransform() {
+        modelMatrix = glm::mat4(1.0f);
+        modelMatrix = glm::translate(modelMatrix, offset);  // apply translation (offset)
+        modelMatrix = glm::scale(modelMatrix, scale);       // apply scaling
+        modelMatrix = modelMatrix * glm::rotate(glm::mat4(1.0f), theta, direction);
+        inverseModelMatrix = glm::inverse(modelMatrix);
+    }
+
+    // called whenever offset, theta or direction change; also refreshes the cached matrices
     void updateTransformedBoundingBox() {
-        transformedMin = transformPoint(bboxMin);
-        transformedMax = transformPoint(bboxMax);
+        updateTransform();
+        transformedMin = transformPoint(asset->bboxMin);
+        transformedMax = transformPoint(asset->bboxMax);
 
         glm::vec3 actualMin, actualMax;
 
@@ -422,40 +464,7 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
 {
     string filename = string(path);
     filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureCache::instance().load(filename);
 }
 
 
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef PARABOLOID_SHADOW_H
+#define PARABOLOID_SHADOW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// how the point light's shadow is stored
+enum PointShadowBackend {
+    POINT_SHADOW_CUBE,       // six 90 degree faces (ShadowCache)
+    POINT_SHADOW_PARABOLOID  // two paraboloid hemispheres (ParaboloidShadow)
+};
+
+// Dual-paraboloid shadow map: the sphere of directions around the light is split at the
+// horizontal plane through it and each half is warped onto a paraboloid, so two 2D layers
+// replace the six cube faces. The warp happens in the vertex shader (PARABOLOID variant of
+// 3.2.2.point_shadows_depth.vs), one draw per hemisphere and no geometry shader. Only the
+// vertices are warped and the edges stay straight, so casters need a fine enough tessellation;
+// the room walls are left out, they surround the light and cannot shadow anything inside.
+// Layer 0 looks down (-y), layer 1 up. The light hangs just under the ceiling, so nearly
+// everything is in layer 0.
+class ParaboloidShadow {
+public:
+    static const unsigned int DOWN = 0;
+    static const unsigned int UP = 1;
+
+    ParaboloidShadow() : size(0), depthArray(0) {}
+
+    // needs a current GL context
+    void init(unsigned int mapSize) {
+        size = mapSize;
+        glGenTextures(1, &depthArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, size, size, 2, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        // only read through sampler2DArrayShadow: hardware compare, 2x2 filtered
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(2, layerFBO);
+        for (unsigned int i = 0; i < 2; ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, layerFBO[i]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, i);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // GL_TEXTURE_2D_ARRAY with the two hemispheres
+    unsigned int texture() const {
+        return depthArray;
+    }
+
+    // binds and clears one hemisphere; the caller draws with the hemisphere's axis set
+    void begin(unsigned int hemisphere) {
+        glBindFramebuffer(GL_FRAMEBUFFER, layerFBO[hemisphere]);
+        glViewport(0, 0, size, size);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // the "hemisphere" uniform of the depth shader: sign of y the hemisphere looks along
+    static float axis(unsigned int hemisphere) {
+        return hemisphere == DOWN ? -1.0f : 1.0f;
+    }
+
+    // hemispheres a world space box reaches, bit 0 down and bit 1 up
+    static unsigned int boxHemispheres(const glm::vec3& lightPos, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        unsigned int mask = 0;
+        if (boxMin.y <= lightPos.y)
+            mask |= 1u << DOWN;
+        if (boxMax.y >= lightPos.y)
+            mask |= 1u << UP;
+        return mask;
+    }
+
+private:
+    unsigned int size;
+    unsigned int depthArray;
+    unsigned int layerFBO[2];
+};
+
+#endif // PARABOLOID_SHADOW_H
@@ -7,9 +7,14 @@
 ** option) any later version.
 ******************************************************************/
 #include "ParticleGenerator.h"
+#include "CpuProfiler.h"
+#include "TextureCache.h"
+
+#include <cstddef>
+#include <iostream>
 
 ParticleGenerator::ParticleGenerator(const char* texturePath, unsigned int amount)
-    : amount(amount), texture(loadTexture(texturePath))
+    : particles(amount + SPARK_RESERVE), backend(PARTICLES_CPU), texture(TextureCache::instance().load(texturePath)), instanceVBO(0), instanceCapacity(0)
 {
     this->init();
 }
@@ -17,53 +22,77 @@ ParticleGenerator::ParticleGenerator(const char* texturePath, unsigned int amoun
 
 void ParticleGenerator::Update(float dt, EmitterState& state, unsigned int newParticles, glm::vec3 offset)
 {
-    std::cout << "dt: " << dt << std::endl;
-    std::cout << "vel: " << state.Velocity.x << " " << state.Velocity.y << " " << state.Velocity.z << std::endl;
-    std::cout << "pos: " << state.Position.x << " " << state.Position.y << " " << state.Position.z << std::endl;
     state.Position += state.Velocity * dt;
-    // add new particles 
-    for (unsigned int i = 0; i < newParticles; ++i)
+    unsigned int fireLimit = (unsigned int)this->particles.capacity() - SPARK_RESERVE;
+    if (this->backend == PARTICLES_COMPUTE)
+    {
+        this->compute->emit(state.Position, state.Velocity, newParticles, fireLimit);
+        this->stats.spawned += newParticles;
+        this->compute->update(dt);
+        return;
+    }
+    // add new particles, fire only fills the pool up to the spark reserve
+    unsigned int alive = (unsigned int)this->particles.size();
+    unsigned int room = alive < fireLimit ? fireLimit - alive : 0;
+    if (newParticles > room)
     {
-        int unusedParticle = this->firstUnusedParticle();
-        this->respawnParticle(this->particles[unusedParticle], state, offset);
+        this->stats.overflowed += newParticles - room;
+        newParticles = room;
     }
-    // update all particles
-    for (unsigned int i = 0; i < this->amount; ++i)
+    for (unsigned int i = 0; i < newParticles; ++i)
     {
-        Particle& p = this->particles[i];
-        p.Life -= dt; // reduce life
-        if (p.Life > 0.0f)
-        {	// particle is alive, thus update
-            std::cout << "λñ仯" << p.Velocity.x * dt << " " << p.Velocity.y * dt << " " << p.Velocity.z * dt << std::endl;
-            p.Position -= p.Velocity * dt;
-            p.Color.a -= dt * 2.5f;
-        }
+        Particle particle;
+        this->respawnParticle(particle, state, offset);
+        if (!this->spawnParticle(particle))
+            break;
     }
+    // update all particles, dead ones leave the pool
+    this->particles.update(dt);
+    this->stats.alive = (unsigned int)this->particles.size();
 }
 
-// render all particles
+// render all particles: the live ones are streamed into the instance buffer and drawn with
+// a single instanced call
 void ParticleGenerator::Draw(Shader &shader)
 {
+    PROFILE_SCOPE("ParticleGenerator::Draw");
+    if (this->backend == PARTICLES_COMPUTE)
+    {
+        // the particle buffer is the instance buffer, the live count comes from the GPU
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        this->compute->draw();
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        return;
+    }
+    instances.resize(particles.size());
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        instances[i].offset = particles.getPosition(i);
+        instances[i].color = particles.getColor(i);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+    if (instances.size() > instanceCapacity)
+        instanceCapacity = instances.size() * 2;
+    // orphan last frame's storage so the upload never waits for the GPU to finish with it
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(ParticleInstance), NULL, GL_STREAM_DRAW);
+    if (!instances.empty())
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(ParticleInstance), &instances[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
     // use additive blending to give it a 'glow' effect
     glBlendFunc(GL_SRC_ALPHA, GL_ONE);
     // shader.use();
-    for (int i = 0; i < particles.size(); i++)
+    if (!instances.empty())
     {
-        if (particles[i].Life > 0.0f)
-        {
-            std::cout << " " << i << " " << std::endl;
-            shader.setVec3("offset", particles[i].Position);
-            std::cout << particles[i].Position.x << " " << particles[i].Position.y << " " << particles[i].Position.z << std::endl;
-
-            shader.setVec3("color", particles[i].Color);
-            std::cout << particles[i].Color.x << " " << particles[i].Color.y << " " << particles[i].Color.z << std::endl;
-
-            glBindVertexArray(this->VAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texture);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glBindVertexArray(0);
-        }
+        glBindVertexArray(this->VAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)instances.size());
+        glBindVertexArray(0);
     }
     // don't forget to reset to default blending mode
     // glEnable(GL_PROGRAM_POINT_SIZE);
@@ -95,35 +124,60 @@ void ParticleGenerator::init()
     // set mesh attributes
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    // per-instance position and color, filled every frame by Draw
+    glGenBuffers(1, &this->instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, offset));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, color));
+    glVertexAttribDivisor(2, 1);
     glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    // create this->amount default particle instances
-    for (unsigned int i = 0; i < this->amount; ++i)
-        this->particles.push_back(Particle());
+void ParticleGenerator::setBackend(ParticleBackend backend)
+{
+    if (backend == PARTICLES_COMPUTE && !ComputeParticles::supported())
+    {
+        std::cout << "ParticleGenerator: compute shaders need OpenGL 4.3, staying on the CPU" << std::endl;
+        backend = PARTICLES_CPU;
+    }
+    if (backend == PARTICLES_COMPUTE)
+    {
+        if (!this->compute)
+            this->compute.reset(new ComputeParticles((unsigned int)this->particles.capacity()));
+        this->compute->clear();
+    }
+    this->particles.clear();
+    this->stats = ParticleStats();
+    this->backend = backend;
 }
 
-// stores the index of the last particle used (for quick access to next dead particle)
-unsigned int lastUsedParticle = 0;
-unsigned int ParticleGenerator::firstUnusedParticle()
+const ParticleStats& ParticleGenerator::getStats()
 {
-    // first search from last used particle, this will usually return almost instantly
-    for (unsigned int i = lastUsedParticle; i < this->amount; ++i) {
-        if (this->particles[i].Life <= 0.0f) {
-            lastUsedParticle = i;
-            std::cout << i << "" << std::endl;
-            return i;
-        }
+    if (this->backend == PARTICLES_COMPUTE)
+    {
+        unsigned int overflowed = 0;
+        this->compute->readCounters(this->stats.alive, overflowed);
+        // spawned counted every request, the GPU knows which of them were dropped
+        this->stats.spawned -= overflowed - this->stats.overflowed;
+        this->stats.overflowed = overflowed;
     }
-    // otherwise, do a linear search
-    for (unsigned int i = 0; i < lastUsedParticle; ++i) {
-        if (this->particles[i].Life <= 0.0f) {
-            lastUsedParticle = i;
-            return i;
-        }
+    return this->stats;
+}
+
+// when the pool is full the request is counted in the stats instead of reusing a live particle
+bool ParticleGenerator::spawnParticle(const Particle& particle)
+{
+    if (!this->particles.add(particle)) {
+        this->stats.overflowed++;
+        return false;
     }
-    // all particles are taken, override the first one (note that if it repeatedly hits this case, more particles should be reserved)
-    lastUsedParticle = 0;
-    return 0;
+    this->stats.spawned++;
+    this->stats.alive = (unsigned int)this->particles.size();
+    return true;
 }
 
 void ParticleGenerator::respawnParticle(Particle& particle, EmitterState& state, glm::vec3 offset)
@@ -135,9 +189,6 @@ void ParticleGenerator::respawnParticle(Particle& particle, EmitterState& state,
     glm::vec3 random = glm::vec3(random_x, random_y, random_z);
     float rColor = 0.5f + ((rand() % 100) / 200.0f);
     particle.Position = state.Position + random;
-    std::cout << "statePos: " << state.Position.x << " " << state.Position.y << " " << state.Position.z << std::endl;
-    // std::cout << "random: " << random << std::endl;
-    std::cout << "particle.Position: " << particle.Position.x << " " << particle.Position.y << " " << particle.Position.z << std::endl;
     particle.Color = glm::vec4(rColor, rColor, rColor, 1.0f);
     particle.Life = 0.2f;
     random_x = (((rand() % 100) - 200)) / 200.0f;
@@ -147,50 +198,17 @@ void ParticleGenerator::respawnParticle(Particle& particle, EmitterState& state,
 }
 
 
-unsigned int ParticleGenerator::loadTexture(const char* path)
+void ParticleGenerator::createSparks(EmitterState& state, unsigned int numberOfSparks, glm::vec3 offset, bool isAdd)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
+    if (this->backend == PARTICLES_COMPUTE)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        this->compute->emitSparks(state.Position, state.Velocity, offset, numberOfSparks, isAdd);
+        this->stats.spawned += numberOfSparks;
+        return;
     }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
-
-
-void ParticleGenerator::createSparks(EmitterState& state, unsigned int numberOfSparks, glm::vec3 offset, bool isAdd)
-{
     for (unsigned int i = 0; i < numberOfSparks; ++i)
     {
-        int unusedParticle = this->firstUnusedParticle();
-        Particle& spark = this->particles[amount - numberOfSparks + i];
+        Particle spark;
 
         // ٶ
         float spread = 3.0f;
@@ -214,5 +232,7 @@ void ParticleGenerator::createSparks(EmitterState& state, unsigned int numberOfS
 
         // óʼλ
         spark.Position = state.Position + offset;
+        if (!this->spawnParticle(spark))
+            break;
     }
 }
\ No newline at end of file
@@ -9,24 +9,17 @@
 ******************************************************************/
 #ifndef PARTICLE_GENERATOR_H
 #define PARTICLE_GENERATOR_H
+#include <memory>
 #include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
-#include "stb_image.h"
 
+#include "ComputeParticles.h"
+#include "ParticleStore.h"
 #include "Shader.h"
 
 
-// Represents a single particle and its state
-struct Particle {
-    glm::vec3 Position, Velocity;
-    glm::vec4 Color;
-    float     Life;
-
-    Particle() : Position(0.0f), Velocity(0.0f), Color(glm::vec4(1.0f, 0.2f, 0.1f, 1.0f)), Life(0.0f) { }
-};
-
 // Represents the state of an emitter that emits particles
 struct EmitterState {
     glm::vec3 Position;
@@ -37,34 +30,65 @@ struct EmitterState {
 };
 
 
+// Where a generator simulates its particles
+enum ParticleBackend {
+    PARTICLES_CPU,     // ParticleStore on the CPU, instances streamed every frame
+    PARTICLES_COMPUTE  // ComputeParticles, state never leaves the GPU (GL 4.3)
+};
+
+// Pool usage of one generator
+struct ParticleStats {
+    unsigned int alive = 0;
+    unsigned int spawned = 0;    // particles handed out since creation
+    unsigned int overflowed = 0; // spawn requests dropped because the pool was full
+};
+
 // ParticleGenerator acts as a container for rendering a large number of 
 // particles by repeatedly spawning and updating particles and killing 
 // them after a given amount of time.
 class ParticleGenerator
 {
 public:
-    // constructor
+    // pool slots the fire emission leaves free for collision sparks
+    static const unsigned int SPARK_RESERVE = 100;
+
+    // constructor; the pool holds amount fire particles plus SPARK_RESERVE sparks
     ParticleGenerator(const char* texturePath, unsigned int amount);
     // update all particles
     void Update(float dt, EmitterState& state, unsigned int newParticles, glm::vec3 offset = glm::vec3(0.0f, 0.0f, 0.0f));
     // render all particles
     void Draw(Shader &shader);
     void createSparks(EmitterState& state, unsigned int numberOfSparks, glm::vec3 offset, bool isAdd);
+    // switches the simulation between CPU and GPU; the pool starts empty on the new backend.
+    // Falls back to the CPU when compute shaders are not available.
+    void setBackend(ParticleBackend backend);
+    ParticleBackend getBackend() const { return backend; }
+    // on the compute backend this reads the GPU counters back, which waits for the GPU
+    const ParticleStats& getStats();
 private:
     // state
-    std::vector<Particle> particles;
-    unsigned int amount;
+    ParticleStore particles;
+    ParticleStats stats;
+    ParticleBackend backend;
+    std::unique_ptr<ComputeParticles> compute; // created on first use of the compute backend
+    // per-instance data of one live particle, streamed to the GPU every frame
+    struct ParticleInstance {
+        glm::vec3 offset;
+        glm::vec4 color;
+    };
+
     // render stat
     unsigned int texture;
     unsigned int VAO;
+    unsigned int instanceVBO;
+    size_t instanceCapacity;
+    std::vector<ParticleInstance> instances;
     // initializes buffer and vertex attributes
     void init();
-    // returns the first Particle index that's currently unused e.g. Life <= 0.0f or 0 if no particle is currently inactive
-    unsigned int firstUnusedParticle();
+    // adds a particle to the pool in O(1), false if the pool is full
+    bool spawnParticle(const Particle& particle);
     // respawns particle
     void respawnParticle(Particle& particle, EmitterState& state, glm::vec3 offset = glm::vec3(0.0f, 0.0f, 0.0f));
-
-    unsigned int loadTexture(const char* path);
    
 };
 
@@ -0,0 +1,104 @@
+#include "ParticleStore.h"
+#include "CpuProfiler.h"
+#include "WorkerPool.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PARTICLE_STORE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLE_STORE_SSE2 1
+#endif
+
+const size_t ParticleStore::PARALLEL_GRAIN;
+const float ParticleStore::FADE_RATE = 2.5f;
+
+ParticleStore::ParticleStore(size_t capacity) : count(0) {
+    posX.resize(capacity); posY.resize(capacity); posZ.resize(capacity);
+    velX.resize(capacity); velY.resize(capacity); velZ.resize(capacity);
+    red.resize(capacity); green.resize(capacity); blue.resize(capacity); alpha.resize(capacity);
+    life.resize(capacity);
+}
+
+bool ParticleStore::add(const Particle& particle) {
+    if (count == capacity())
+        return false;
+    size_t i = count++;
+    posX[i] = particle.Position.x; posY[i] = particle.Position.y; posZ[i] = particle.Position.z;
+    velX[i] = particle.Velocity.x; velY[i] = particle.Velocity.y; velZ[i] = particle.Velocity.z;
+    red[i] = particle.Color.r; green[i] = particle.Color.g; blue[i] = particle.Color.b; alpha[i] = particle.Color.a;
+    life[i] = particle.Life;
+    return true;
+}
+
+void ParticleStore::update(float deltaTime, bool parallel) {
+    PROFILE_SCOPE("ParticleStore::update");
+    if (parallel && count > PARALLEL_GRAIN) {
+        WorkerPool::instance().parallelFor(count, PARALLEL_GRAIN, [this, deltaTime](size_t begin, size_t end) {
+            updateRange(begin, end, deltaTime);
+        });
+    }
+    else {
+        updateRange(0, count, deltaTime);
+    }
+    removeDead();
+}
+
+// reference implementation, also handles the tail the vector kernels leave over.
+// Particles that die in this step are moved too; removeDead() drops them right after.
+void ParticleStore::updateScalar(size_t begin, size_t end, float deltaTime) {
+    float fade = FADE_RATE * deltaTime;
+    for (size_t i = begin; i < end; ++i) {
+        life[i] -= deltaTime;
+        posX[i] -= velX[i] * deltaTime;
+        posY[i] -= velY[i] * deltaTime;
+        posZ[i] -= velZ[i] * deltaTime;
+        alpha[i] -= fade;
+    }
+}
+
+// begin is a multiple of PARALLEL_GRAIN (or 0), so the aligned loads stay aligned
+void ParticleStore::updateRange(size_t begin, size_t end, float deltaTime) {
+    size_t i = begin;
+
+#if defined(PARTICLE_STORE_AVX)
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 fade = _mm256_set1_ps(FADE_RATE * deltaTime);
+    for (; i + 8 <= end; i += 8) {
+        _mm256_store_ps(&life[i], _mm256_sub_ps(_mm256_load_ps(&life[i]), dt));
+        _mm256_store_ps(&posX[i], _mm256_sub_ps(_mm256_load_ps(&posX[i]), _mm256_mul_ps(_mm256_load_ps(&velX[i]), dt)));
+        _mm256_store_ps(&posY[i], _mm256_sub_ps(_mm256_load_ps(&posY[i]), _mm256_mul_ps(_mm256_load_ps(&velY[i]), dt)));
+        _mm256_store_ps(&posZ[i], _mm256_sub_ps(_mm256_load_ps(&posZ[i]), _mm256_mul_ps(_mm256_load_ps(&velZ[i]), dt)));
+        _mm256_store_ps(&alpha[i], _mm256_sub_ps(_mm256_load_ps(&alpha[i]), fade));
+    }
+#elif defined(PARTICLE_STORE_SSE2)
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 fade = _mm_set1_ps(FADE_RATE * deltaTime);
+    for (; i + 4 <= end; i += 4) {
+        _mm_store_ps(&life[i], _mm_sub_ps(_mm_load_ps(&life[i]), dt));
+        _mm_store_ps(&posX[i], _mm_sub_ps(_mm_load_ps(&posX[i]), _mm_mul_ps(_mm_load_ps(&velX[i]), dt)));
+        _mm_store_ps(&posY[i], _mm_sub_ps(_mm_load_ps(&posY[i]), _mm_mul_ps(_mm_load_ps(&velY[i]), dt)));
+        _mm_store_ps(&posZ[i], _mm_sub_ps(_mm_load_ps(&posZ[i]), _mm_mul_ps(_mm_load_ps(&velZ[i]), dt)));
+        _mm_store_ps(&alpha[i], _mm_sub_ps(_mm_load_ps(&alpha[i]), fade));
+    }
+#endif
+
+    updateScalar(i, end, deltaTime);
+}
+
+// swap-remove: a dead particle takes the data of the last live one, which was already
+// updated, so it is checked again before moving on
+void ParticleStore::removeDead() {
+    size_t i = 0;
+    while (i < count) {
+        if (life[i] > 0.0f) {
+            ++i;
+            continue;
+        }
+        size_t last = --count;
+        posX[i] = posX[last]; posY[i] = posY[last]; posZ[i] = posZ[last];
+        velX[i] = velX[last]; velY[i] = velY[last]; velZ[i] = velZ[last];
+        red[i] = red[last]; green[i] = green[last]; blue[i] = blue[last]; alpha[i] = alpha[last];
+        life[i] = life[last];
+    }
+}
@@ -6,6 +6,9 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "CpuProfiler.h"
+#include "TextureCache.h"
+
 class Room {
 public:
     Room(float width, float height, float depth, const std::vector<const char*>& texturePaths)
@@ -46,6 +49,23 @@ public:
         glBindVertexArray(0);
     }
 
+    // one wall without textures, for the shadow pass
+    void drawWall(const Shader& shader, int wall) {
+        shader.setMat4("model", model);
+        glBindVertexArray(roomVAO);
+        glDrawArrays(GL_TRIANGLES, wall * 6, 6);
+        glBindVertexArray(0);
+    }
+
+    // world space bounds of a wall
+    const glm::vec3& wallMin(int wall) const {
+        return wallBounds[wall][0];
+    }
+
+    const glm::vec3& wallMax(int wall) const {
+        return wallBounds[wall][1];
+    }
+
     int getTexture(int index) {
         return roomTextures[index];
     }
@@ -56,6 +76,7 @@ private:
     unsigned int roomVAO, roomVBO;
     glm::mat4 model;
     std::vector<unsigned int> roomTextures;
+    glm::vec3 wallBounds[6][2]; // min, max
 
     void initialize() {
         model = glm::scale(glm::mat4(1.0f), glm::vec3(roomWidth / 2.0f, roomHeight / 2.0f, roomDepth / 2.0f));
@@ -118,6 +139,14 @@ private:
         glBindVertexArray(roomVAO);
         glBindBuffer(GL_ARRAY_BUFFER, roomVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        for (int wall = 0; wall < 6; ++wall) {
+            for (int i = 0; i < 6; ++i) {
+                const float* v = &vertices[(wall * 6 + i) * 8];
+                glm::vec3 point = glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f));
+                wallBounds[wall][0] = i == 0 ? point : glm::min(wallBounds[wall][0], point);
+                wallBounds[wall][1] = i == 0 ? point : glm::max(wallBounds[wall][1], point);
+            }
+        }
         // vertex positions
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -130,49 +159,12 @@ private:
         glBindVertexArray(0);
     }
 
-    unsigned int loadTexture(const char* path)
-    {
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-        if (data)
-        {
-            GLenum format;
-            if (nrComponents == 1)
-                format = GL_RED;
-            else if (nrComponents == 3)
-                format = GL_RGB;
-            else if (nrComponents == 4)
-                format = GL_RGBA;
-
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Texture failed to load at path: " << path << std::endl;
-            stbi_image_free(data);
-        }
-
-        return textureID;
-    }
-
     std::vector<unsigned int> loadTextures(const std::vector<const char*>& paths)
     {
         std::vector<unsigned int> textureIDs;
         for (const auto& path : paths)
         {
-            textureIDs.push_back(loadTexture(path));
+            textureIDs.push_back(TextureCache::instance().load(path));
         }
         return textureIDs;
     }
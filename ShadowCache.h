@@ -0,0 +1,208 @@
+#pragma once
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// shadow filtering tiers of the lighting shader, compiled as variants of 3.2.2.point_shadows.fs
+// (SHADOW_QUALITY define, same values)
+enum ShadowQuality {
+    SHADOW_OFF,   // no shadow lookups
+    SHADOW_HARD,  // one hardware compare tap (samplerCubeShadow)
+    SHADOW_PCF4,  // 4 compare taps, 20 where they disagree
+    SHADOW_PCF20, // 20 taps with manual compares
+    SHADOW_ESM,   // one linear fetch of the blurred exponential shadow map (ShadowFilter)
+    SHADOW_QUALITY_COUNT
+};
+
+inline const char* shadowQualityName(ShadowQuality quality) {
+    static const char* names[SHADOW_QUALITY_COUNT] = { "off", "hard", "pcf4", "pcf20", "esm" };
+    return names[quality];
+}
+
+// the tier with the given name, fallback if there is none
+inline ShadowQuality parseShadowQuality(const std::string& name, ShadowQuality fallback) {
+    for (int i = 0; i < SHADOW_QUALITY_COUNT; ++i) {
+        if (name == shadowQualityName((ShadowQuality)i))
+            return (ShadowQuality)i;
+    }
+    return fallback;
+}
+
+inline std::string shadowQualityDefines(ShadowQuality quality) {
+    return "#define SHADOW_QUALITY " + std::to_string((int)quality) + "\n";
+}
+
+// Point light shadow cube map split into a static and a dynamic layer. The light never moves,
+// so the casters that do not move either (the room, tumblers at rest) are rendered once into a
+// persistent cube map. Every frame that layer is copied into the cube map the lighting pass
+// samples and only the dynamic casters (balls, wobbling or dragged tumblers) are drawn on top;
+// the depth test keeps the nearer of both. The static layer is rendered again only when the
+// set of static casters or one of their transforms changes.
+// Both layers can be drawn to as a whole (layered FBO, for the geometry shader that writes
+// every face) or one face at a time (bindFace, for casters culled per face).
+class ShadowCache {
+public:
+    ShadowCache() : size(0), staticCubemap(0), depthCubemap(0), staticFBO(0), depthFBO(0),
+        target(0), compareSampler(0), staticValid(false), staticRenders(0) {}
+
+    // needs a current GL context
+    void init(unsigned int cubeSize) {
+        size = cubeSize;
+        staticCubemap = createCubemap();
+        depthCubemap = createCubemap();
+        staticFBO = createFBO(staticCubemap);
+        depthFBO = createFBO(depthCubemap);
+        for (unsigned int i = 0; i < 6; ++i) {
+            faceFBO[0][i] = createFaceFBO(staticCubemap, i);
+            faceFBO[1][i] = createFaceFBO(depthCubemap, i);
+        }
+        // depth only, like the shadow FBOs
+        glGenFramebuffers(2, copyFBO);
+        for (int i = 0; i < 2; ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, copyFBO[i]);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // hardware depth compare for the samplerCubeShadow tiers; linear filtering makes
+        // every tap a 2x2 compare
+        glGenSamplers(1, &compareSampler);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+
+    // the cube map the lighting pass samples
+    unsigned int cubemap() const {
+        return depthCubemap;
+    }
+
+    // the cached static casters only
+    unsigned int staticLayer() const {
+        return staticCubemap;
+    }
+
+    // sampler object to bind with cubemap() for the given tier, 0 for the texture's own state
+    unsigned int sampler(ShadowQuality quality) const {
+        return quality == SHADOW_HARD || quality == SHADOW_PCF4 ? compareSampler : 0;
+    }
+
+    // key has one entry per caster that can be static: its model matrix while it is static,
+    // a zero matrix while it is dynamic. Returns true when the static layer has to be rendered
+    // again, that is on the first frame and whenever the key changed since the last render
+    bool updateStatic(const std::vector<glm::mat4>& key) {
+        if (staticValid && key == staticKey)
+            return false;
+        staticKey = key;
+        staticValid = true;
+        staticRenders++;
+        return true;
+    }
+
+    // forces a static render on the next updateStatic
+    void invalidate() {
+        staticValid = false;
+    }
+
+    // binds the static layer, cleared; the caller draws the static casters
+    void beginStatic() {
+        glBindFramebuffer(GL_FRAMEBUFFER, staticFBO);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        target = 0;
+    }
+
+    // copies the static layer into the shadow map and binds it for the dynamic casters
+    void beginDynamic() {
+        if (GLAD_GL_VERSION_4_3) {
+            glCopyImageSubData(staticCubemap, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0,
+                depthCubemap, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0, size, size, 6);
+        }
+        else {
+            // one depth blit per face
+            for (unsigned int i = 0; i < 6; ++i) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFBO[0]);
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, staticCubemap, 0);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copyFBO[1]);
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, depthCubemap, 0);
+                glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        target = 1;
+    }
+
+    // binds one face of the layer last begun with beginStatic or beginDynamic
+    void bindFace(unsigned int face) {
+        glBindFramebuffer(GL_FRAMEBUFFER, faceFBO[target][face]);
+    }
+
+    // how often the static layer was rendered, the first render included
+    int staticRenderCount() const {
+        return staticRenders;
+    }
+
+private:
+    unsigned int size;
+    unsigned int staticCubemap;
+    unsigned int depthCubemap;
+    unsigned int staticFBO;
+    unsigned int depthFBO;
+    unsigned int copyFBO[2];
+    unsigned int faceFBO[2][6]; // [static, depth][face]
+    int target;                 // layer bindFace draws to
+    unsigned int compareSampler;
+    bool staticValid;
+    int staticRenders;
+    std::vector<glm::mat4> staticKey;
+
+    unsigned int createCubemap() {
+        unsigned int cubemap;
+        glGenTextures(1, &cubemap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+        for (unsigned int i = 0; i < 6; ++i)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        return cubemap;
+    }
+
+    // layered FBO with the whole cube map as depth attachment, for the geometry shader
+    unsigned int createFBO(unsigned int cubemap) {
+        unsigned int fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubemap, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return fbo;
+    }
+
+    // FBO with one face of the cube map as depth attachment
+    unsigned int createFaceFBO(unsigned int cubemap, unsigned int face) {
+        unsigned int fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubemap, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return fbo;
+    }
+};
+
+#endif // SHADOW_CACHE_H
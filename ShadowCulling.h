@@ -0,0 +1,113 @@
+#pragma once
+#ifndef SHADOW_CULLING_H
+#define SHADOW_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// world space box around the eight corners of a model space box drawn with the given matrix
+inline void transformBox(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& model,
+    glm::vec3& worldMin, glm::vec3& worldMax) {
+    worldMin = glm::vec3(INFINITY);
+    worldMax = glm::vec3(-INFINITY);
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 point((corner & 1) ? boxMax.x : boxMin.x,
+            (corner & 2) ? boxMax.y : boxMin.y,
+            (corner & 4) ? boxMax.z : boxMin.z);
+        point = glm::vec3(model * glm::vec4(point, 1.0f));
+        worldMin = glm::min(worldMin, point);
+        worldMax = glm::max(worldMax, point);
+    }
+}
+
+// CPU culling of shadow casters against the six 90 degree frusta of a point light cube map.
+// Faces are in the order of the shadow transforms and cube map layers: +X, -X, +Y, -Y, +Z, -Z.
+// A face frustum is bounded by four planes through the light and the far plane; the near plane
+// is left out, so the tests are conservative. The result is a mask with bit i set when the
+// bounds may touch face i; the caster is drawn into those faces only.
+class CubeFaceCuller {
+public:
+    static const unsigned int ALL_FACES = 0x3F;
+
+    CubeFaceCuller() : lightPos(0.0f) {}
+
+    void setLight(const glm::vec3& position, float farPlane) {
+        lightPos = position;
+        for (int face = 0; face < 6; ++face) {
+            int axis = face / 2;
+            float sign = face % 2 == 0 ? 1.0f : -1.0f;
+            glm::vec3 forward(0.0f);
+            forward[axis] = sign;
+            int plane = 0;
+            for (int other = 0; other < 3; ++other) {
+                if (other == axis)
+                    continue;
+                glm::vec3 side(0.0f);
+                side[other] = 1.0f;
+                // 45 degree side planes: the distance along the face axis is at least |d[other]|
+                planes[face][plane++] = Plane(forward - side, 0.0f);
+                planes[face][plane++] = Plane(forward + side, 0.0f);
+            }
+            planes[face][plane] = Plane(-forward, farPlane);
+        }
+    }
+
+    // world space axis aligned box
+    unsigned int boxFaces(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+        glm::vec3 center = (boxMin + boxMax) * 0.5f - lightPos;
+        glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+        unsigned int mask = 0;
+        for (int face = 0; face < 6; ++face) {
+            bool inside = true;
+            for (int i = 0; i < PLANES && inside; ++i) {
+                const Plane& p = planes[face][i];
+                float reach = std::abs(p.normal.x) * extent.x + std::abs(p.normal.y) * extent.y + std::abs(p.normal.z) * extent.z;
+                inside = glm::dot(p.normal, center) + p.offset + reach >= 0.0f;
+            }
+            if (inside)
+                mask |= 1u << face;
+        }
+        return mask;
+    }
+
+    // model space box drawn with the given model matrix; culled with the world space box
+    // around its eight transformed corners
+    unsigned int boxFaces(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& model) const {
+        glm::vec3 worldMin, worldMax;
+        transformBox(boxMin, boxMax, model, worldMin, worldMax);
+        return boxFaces(worldMin, worldMax);
+    }
+
+    unsigned int sphereFaces(const glm::vec3& center, float radius) const {
+        glm::vec3 d = center - lightPos;
+        unsigned int mask = 0;
+        for (int face = 0; face < 6; ++face) {
+            bool inside = true;
+            for (int i = 0; i < PLANES && inside; ++i) {
+                const Plane& p = planes[face][i];
+                inside = glm::dot(p.normal, d) + p.offset >= -radius * glm::length(p.normal);
+            }
+            if (inside)
+                mask |= 1u << face;
+        }
+        return mask;
+    }
+
+private:
+    static const int PLANES = 5;
+
+    // inside where dot(normal, point - lightPos) + offset >= 0
+    struct Plane {
+        glm::vec3 normal;
+        float offset;
+
+        Plane() : normal(0.0f), offset(0.0f) {}
+        Plane(const glm::vec3& n, float o) : normal(n), offset(o) {}
+    };
+
+    glm::vec3 lightPos;
+    Plane planes[6][PLANES];
+};
+
+#endif // SHADOW_CULLING_H
@@ -0,0 +1,164 @@
+#pragma once
+#ifndef SHADOW_FILTER_H
+#define SHADOW_FILTER_H
+
+#include <glad/glad.h>
+
+#include "ShadowCache.h"
+#include "Shader.h"
+
+// Exponential shadow map (ESM) built from the depth cube maps of a ShadowCache. Every texel
+// holds exp(EXPONENT * depth) blurred with a separable 5x5 kernel, so the lighting shader gets
+// a filtered shadow from one linear fetch instead of 20 depth compares.
+// The blur is amortised like the depth layers: the static layer is filtered into its own ESM
+// cube map only when ShadowCache renders it again, and each frame only the faces the dynamic
+// casters touch are filtered from the composed depth map. Faces the dynamic casters left since
+// the last frame are restored from the static ESM with a blit; all other faces stay as they are.
+// Blurring the composed depth map per face keeps the result exact where dynamic casters are.
+class ShadowFilter {
+public:
+    static constexpr float EXPONENT = 80.0f; // depth is distance / far_plane, in [0, 1]
+    static const unsigned int ALL_FACES = 0x3F;
+
+    ShadowFilter() : size(0), esmStatic(0), esmCubemap(0), scratch(0), scratchFBO(0), emptyVAO(0),
+        horizontal(nullptr), vertical(nullptr), filteredStatic(-1), lastDynamic(ALL_FACES) {}
+
+    ~ShadowFilter() {
+        delete horizontal;
+        delete vertical;
+    }
+
+    // needs a current GL context
+    void init(unsigned int cubeSize) {
+        size = cubeSize;
+        esmStatic = createCubemap();
+        esmCubemap = createCubemap();
+        for (unsigned int i = 0; i < 6; ++i) {
+            faceFBO[0][i] = createFaceFBO(esmStatic, i);
+            faceFBO[1][i] = createFaceFBO(esmCubemap, i);
+        }
+
+        glGenTextures(1, &scratch);
+        glBindTexture(GL_TEXTURE_2D, scratch);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &scratchFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, scratchFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scratch, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenVertexArrays(1, &emptyVAO);
+        horizontal = new Shader("esm_filter.vs", "esm_filter_fs.vs", nullptr, "#define HORIZONTAL\n");
+        vertical = new Shader("esm_filter.vs", "esm_filter_fs.vs");
+        horizontal->use();
+        horizontal->setInt("depthMap", 0);
+        horizontal->setInt("size", (int)size);
+        horizontal->setFloat("exponent", EXPONENT);
+        vertical->use();
+        vertical->setInt("source", 0);
+        vertical->setInt("size", (int)size);
+
+        // linear fetches near a face edge blend with the neighbouring face
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    }
+
+    // the ESM cube map the lighting pass samples, R32F with linear filtering
+    unsigned int cubemap() const {
+        return esmCubemap;
+    }
+
+    // the ESM cube map no longer matches the depth layers, e.g. after frames without update
+    void invalidate() {
+        filteredStatic = -1;
+    }
+
+    // call after the shadow pass; dynamicFaces has bit i set when dynamic casters were drawn
+    // into face i this frame
+    void update(const ShadowCache& cache, unsigned int dynamicFaces) {
+        unsigned int restore = lastDynamic & ~dynamicFaces;
+        if (filteredStatic != cache.staticRenderCount()) {
+            for (unsigned int face = 0; face < 6; ++face)
+                filterFace(cache.staticLayer(), face, faceFBO[0][face]);
+            filteredStatic = cache.staticRenderCount();
+            restore = ALL_FACES & ~dynamicFaces;
+        }
+        for (unsigned int face = 0; face < 6; ++face) {
+            if (restore & (1u << face)) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, faceFBO[0][face]);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, faceFBO[1][face]);
+                glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            }
+            else if (dynamicFaces & (1u << face)) {
+                filterFace(cache.cubemap(), face, faceFBO[1][face]);
+            }
+        }
+        lastDynamic = dynamicFaces;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+private:
+    unsigned int size;
+    unsigned int esmStatic;
+    unsigned int esmCubemap;
+    unsigned int faceFBO[2][6]; // [static, final][face]
+    unsigned int scratch;       // horizontal pass result
+    unsigned int scratchFBO;
+    unsigned int emptyVAO;
+    Shader* horizontal;
+    Shader* vertical;
+    int filteredStatic;         // ShadowCache::staticRenderCount of the static ESM, -1 for none
+    unsigned int lastDynamic;   // faces filtered from the composed depth map last frame
+
+    // blurs one face of a depth cube map into the face FBO of an ESM cube map
+    void filterFace(unsigned int depthCubemap, unsigned int face, unsigned int target) {
+        glViewport(0, 0, size, size);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(emptyVAO);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, scratchFBO);
+        horizontal->use();
+        horizontal->setInt("face", (int)face);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        vertical->use();
+        glBindTexture(GL_TEXTURE_2D, scratch);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    unsigned int createCubemap() {
+        unsigned int cubemap;
+        glGenTextures(1, &cubemap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+        for (unsigned int i = 0; i < 6; ++i)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        return cubemap;
+    }
+
+    unsigned int createFaceFBO(unsigned int cubemap, unsigned int face) {
+        unsigned int fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubemap, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return fbo;
+    }
+
+    ShadowFilter(const ShadowFilter&) = delete;
+    ShadowFilter& operator=(const ShadowFilter&) = delete;
+};
+
+#endif // SHADOW_FILTER_H
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef SIMULATION_CLOCK_H
+#define SIMULATION_CLOCK_H
+
+#include <algorithm>
+
+// Fixed-step simulation clock. The render loop feeds it the variable frame time; it hands
+// back how many fixed steps to simulate and the fraction of a step left over, which the
+// renderer uses to interpolate between the previous and the current simulation state.
+class SimulationClock {
+public:
+    SimulationClock(float stepsPerSecond = 120.0f, int maxStepsPerFrame = 8)
+        : fixedStep(1.0f / stepsPerSecond), maxSteps(maxStepsPerFrame), accumulator(0.0f) {}
+
+    // add one frame's worth of time and return the number of fixed steps to run
+    int advance(float frameDelta) {
+        // a long stall (window drag, breakpoint) must not turn into a burst of catch-up steps
+        accumulator += std::min(std::max(frameDelta, 0.0f), fixedStep * maxSteps);
+        int steps = 0;
+        while (accumulator >= fixedStep && steps < maxSteps) {
+            accumulator -= fixedStep;
+            steps++;
+        }
+        return steps;
+    }
+
+    float step() const {
+        return fixedStep;
+    }
+
+    // blend factor between the previous and the current simulation state, in [0, 1)
+    float alpha() const {
+        return std::min(accumulator / fixedStep, 1.0f);
+    }
+
+    void reset() {
+        accumulator = 0.0f;
+    }
+
+private:
+    float fixedStep;
+    int maxSteps;
+    float accumulator;
+};
+
+#endif // SIMULATION_CLOCK_H
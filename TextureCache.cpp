@@ -0,0 +1,153 @@
+#include "TextureCache.h"
+#include "CpuProfiler.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <iostream>
+
+TextureCache& TextureCache::instance() {
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::TextureCache() {
+    // keep one core for the GL thread
+    unsigned int count = std::max(1u, std::thread::hardware_concurrency() - 1);
+    count = std::min(count, 4u);
+    for (unsigned int i = 0; i < count; ++i)
+        workers.push_back(std::thread(&TextureCache::workerLoop, this));
+}
+
+TextureCache::~TextureCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    for (auto& it : entries) {
+        if (it.second.image)
+            stbi_image_free(it.second.image->data);
+    }
+}
+
+void TextureCache::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        int width = 0, height = 0, components = 0;
+        unsigned char* data;
+        {
+            PROFILE_SCOPE("TextureCache::decode");
+            data = stbi_load(job.path.c_str(), &width, &height, &components, 0);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job.image->data = data;
+            job.image->width = width;
+            job.image->height = height;
+            job.image->components = components;
+            job.image->decoded = true;
+        }
+        imageDecoded.notify_all();
+    }
+}
+
+// entry for the key, queueing the decode if it is new; GL thread only
+TextureCache::Entry& TextureCache::request(const std::string& path, const TextureSampler& sampler) {
+    Entry& entry = entries[Key(path, sampler)];
+    if (entry.id == 0 && !entry.image) {
+        entry.image = std::make_shared<Image>();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Job job = { path, entry.image };
+            jobs.push_back(job);
+        }
+        jobReady.notify_one();
+    }
+    return entry;
+}
+
+void TextureCache::prefetch(const std::string& path, const TextureSampler& sampler) {
+    request(path, sampler);
+}
+
+unsigned int TextureCache::load(const std::string& path, const TextureSampler& sampler) {
+    Key key(path, sampler);
+    Entry& entry = request(path, sampler);
+    if (entry.id != 0)
+        return entry.id;
+
+    {
+        PROFILE_SCOPE("TextureCache::wait");
+        std::unique_lock<std::mutex> lock(mutex);
+        std::shared_ptr<Image> image = entry.image;
+        imageDecoded.wait(lock, [&image] { return image->decoded; });
+    }
+    upload(key, entry);
+    return entry.id;
+}
+
+void TextureCache::update() {
+    for (auto& it : entries) {
+        Entry& entry = it.second;
+        if (entry.id != 0)
+            continue;
+        bool decoded;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded = entry.image->decoded;
+        }
+        if (decoded)
+            upload(it.first, entry);
+    }
+}
+
+// creates the GL texture from the decoded image and releases the pixels
+void TextureCache::upload(const Key& key, Entry& entry) {
+    PROFILE_SCOPE("TextureCache::upload");
+    const TextureSampler& sampler = key.second;
+    Image& image = *entry.image;
+
+    glGenTextures(1, &entry.id);
+    if (image.data)
+    {
+        GLenum format = GL_RGB;
+        if (image.components == 1)
+            format = GL_RED;
+        else if (image.components == 3)
+            format = GL_RGB;
+        else if (image.components == 4)
+            format = GL_RGBA;
+
+        // stb_image rows are tightly packed
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        GLint wrap = sampler.clampAlpha && format == GL_RGBA ? GL_CLAMP_TO_EDGE : sampler.wrap;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+
+        stbi_image_free(image.data);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << key.first << std::endl;
+    }
+    entry.image.reset();
+}
@@ -0,0 +1,91 @@
+#pragma once
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How a cached texture is sampled; part of the cache key, so the same image can exist
+// with different settings
+struct TextureSampler {
+    GLint wrap = GL_REPEAT;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    bool clampAlpha = false; // images with an alpha channel use GL_CLAMP_TO_EDGE, avoids semi-transparent borders
+
+    static TextureSampler clampingAlpha() {
+        TextureSampler sampler;
+        sampler.clampAlpha = true;
+        return sampler;
+    }
+
+    bool operator<(const TextureSampler& other) const {
+        if (wrap != other.wrap) return wrap < other.wrap;
+        if (minFilter != other.minFilter) return minFilter < other.minFilter;
+        if (magFilter != other.magFilter) return magFilter < other.magFilter;
+        return clampAlpha < other.clampAlpha;
+    }
+};
+
+// Every 2D texture of the scene, keyed by path and sampler settings. Images are decoded with
+// stb_image on worker threads; the GL upload happens on the GL thread inside load() or
+// update(), once per key, and every caller gets the same texture id.
+//
+//   prefetch(path)  queue the decode and return at once (any thread)
+//   load(path)      texture id, waits only if the image is still being decoded (GL thread)
+//   update()        upload whatever finished decoding, never waits (GL thread, once per frame)
+class TextureCache {
+public:
+    static TextureCache& instance();
+
+    void prefetch(const std::string& path, const TextureSampler& sampler = TextureSampler());
+    unsigned int load(const std::string& path, const TextureSampler& sampler = TextureSampler());
+    void update();
+
+    ~TextureCache();
+
+private:
+    struct Image {
+        bool decoded = false;
+        unsigned char* data = nullptr;
+        int width = 0, height = 0, components = 0;
+    };
+
+    struct Entry {
+        unsigned int id = 0; // 0 until uploaded
+        std::shared_ptr<Image> image;
+    };
+
+    struct Job {
+        std::string path;
+        std::shared_ptr<Image> image;
+    };
+
+    typedef std::pair<std::string, TextureSampler> Key;
+
+    std::map<Key, Entry> entries;
+    std::deque<Job> jobs;
+    std::vector<std::thread> workers;
+    std::mutex mutex;                  // guards jobs and the Image structs
+    std::condition_variable jobReady;
+    std::condition_variable imageDecoded;
+    bool stopping = false;
+
+    TextureCache();
+    TextureCache(const TextureCache&);
+    TextureCache& operator=(const TextureCache&);
+
+    Entry& request(const std::string& path, const TextureSampler& sampler);
+    void upload(const Key& key, Entry& entry);
+    void workerLoop();
+};
+
+#endif // TEXTURE_CACHE_H
@@ -0,0 +1,105 @@
+#include "TriangleBVH.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cfloat>
+
+void TriangleBVH::build(const std::vector<Mesh>& meshes) {
+    PROFILE_SCOPE("TriangleBVH::build");
+    triangles.clear();
+    order.clear();
+    nodes.clear();
+
+    std::vector<glm::vec3> centroids;
+    for (const Mesh& mesh : meshes) {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            Triangle triangle;
+            triangle.v1 = mesh.vertices[mesh.indices[i]].Position;
+            triangle.v2 = mesh.vertices[mesh.indices[i + 1]].Position;
+            triangle.v3 = mesh.vertices[mesh.indices[i + 2]].Position;
+            triangles.push_back(triangle);
+            centroids.push_back((triangle.v1 + triangle.v2 + triangle.v3) / 3.0f);
+        }
+    }
+    if (triangles.empty())
+        return;
+
+    order.resize(triangles.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    nodes.reserve(2 * triangles.size() / LEAF_SIZE + 1);
+    buildNode(0, (uint32_t)order.size(), centroids);
+}
+
+// median split along the longest axis of the centroids
+uint32_t TriangleBVH::buildNode(uint32_t begin, uint32_t end, const std::vector<glm::vec3>& centroids) {
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.push_back(Node());
+
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+    for (uint32_t i = begin; i < end; ++i) {
+        const Triangle& triangle = triangles[order[i]];
+        boundsMin = glm::min(boundsMin, glm::min(triangle.v1, glm::min(triangle.v2, triangle.v3)));
+        boundsMax = glm::max(boundsMax, glm::max(triangle.v1, glm::max(triangle.v2, triangle.v3)));
+        centroidMin = glm::min(centroidMin, centroids[order[i]]);
+        centroidMax = glm::max(centroidMax, centroids[order[i]]);
+    }
+    nodes[index].boundsMin = boundsMin;
+    nodes[index].boundsMax = boundsMax;
+
+    if (end - begin <= LEAF_SIZE) {
+        nodes[index].first = begin;
+        nodes[index].count = end - begin;
+        return index;
+    }
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent.x)
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+    uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+        [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    buildNode(begin, middle, centroids);
+    uint32_t right = buildNode(middle, end, centroids);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+void TriangleBVH::query(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const {
+    if (nodes.empty())
+        return;
+    glm::vec3 queryMin = center - glm::vec3(radius);
+    glm::vec3 queryMax = center + glm::vec3(radius);
+
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (queryMin.x > node.boundsMax.x || queryMax.x < node.boundsMin.x ||
+            queryMin.y > node.boundsMax.y || queryMax.y < node.boundsMin.y ||
+            queryMin.z > node.boundsMax.z || queryMax.z < node.boundsMin.z)
+            continue;
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const Triangle& triangle = triangles[order[i]];
+                glm::vec3 triangleMin = glm::min(triangle.v1, glm::min(triangle.v2, triangle.v3));
+                glm::vec3 triangleMax = glm::max(triangle.v1, glm::max(triangle.v2, triangle.v3));
+                if (queryMin.x <= triangleMax.x && queryMax.x >= triangleMin.x &&
+                    queryMin.y <= triangleMax.y && queryMax.y >= triangleMin.y &&
+                    queryMin.z <= triangleMax.z && queryMax.z >= triangleMin.z)
+                    result.push_back(order[i]);
+            }
+            continue;
+        }
+        uint32_t self = (uint32_t)(&node - &nodes[0]);
+        stack[top++] = node.first;
+        stack[top++] = self + 1;
+    }
+}
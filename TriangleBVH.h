@@ -0,0 +1,53 @@
+#pragma once
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+// Bounding volume hierarchy over the triangles of a model, in model space. It is built once
+// after loading; the model's transform is applied to the query instead, so wobbling or
+// dragging the model never invalidates it.
+class TriangleBVH {
+public:
+    static const int LEAF_SIZE = 4;
+
+    struct Triangle {
+        glm::vec3 v1, v2, v3;
+    };
+
+    // triangles are numbered in mesh order, then index order, like walking Mesh::indices
+    void build(const std::vector<Mesh>& meshes);
+
+    // appends every triangle whose bounding box overlaps the box around the sphere
+    void query(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const;
+
+    const Triangle& triangle(uint32_t index) const {
+        return triangles[index];
+    }
+
+    size_t triangleCount() const {
+        return triangles.size();
+    }
+
+private:
+    // depth-first layout: an inner node's left child follows it directly
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        uint32_t first; // leaf: first entry in order, inner: index of the right child
+        uint32_t count; // triangles in the leaf, 0 for inner nodes
+    };
+
+    std::vector<Triangle> triangles;
+    std::vector<uint32_t> order; // triangle indices grouped by leaf
+    std::vector<Node> nodes;
+
+    uint32_t buildNode(uint32_t begin, uint32_t end, const std::vector<glm::vec3>& centroids);
+};
+
+#endif // TRIANGLE_BVH_H
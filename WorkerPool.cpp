@@ -0,0 +1,80 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool& WorkerPool::instance() {
+    static WorkerPool pool;
+    return pool;
+}
+
+WorkerPool::WorkerPool() : nextRange(0) {
+    // the calling thread works as well
+    unsigned int count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    count = std::min(count, 15u);
+    for (unsigned int i = 0; i < count; ++i)
+        workers.push_back(std::thread(&WorkerPool::workerLoop, this));
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void WorkerPool::parallelFor(size_t count, size_t grain, const RangeJob& job) {
+    grain = std::max<size_t>(grain, 1);
+    if (count <= grain || workers.empty()) {
+        if (count > 0)
+            job(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> call(callMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        jobCount = count;
+        jobGrain = grain;
+        nextRange = 0;
+        busyWorkers = workers.size();
+        generation++;
+    }
+    jobReady.notify_all();
+    runRanges();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return busyWorkers == 0; });
+    this->job = nullptr;
+}
+
+void WorkerPool::workerLoop() {
+    unsigned int seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        runRanges();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0)
+                jobDone.notify_one();
+        }
+    }
+}
+
+void WorkerPool::runRanges() {
+    for (;;) {
+        size_t begin = nextRange.fetch_add(jobGrain);
+        if (begin >= jobCount)
+            return;
+        (*job)(begin, std::min(begin + jobGrain, jobCount));
+    }
+}
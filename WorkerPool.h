@@ -0,0 +1,55 @@
+#pragma once
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent threads for data-parallel loops inside one simulation step. The threads are
+// started once and sleep between jobs, so a parallelFor costs a wake-up, not a thread start.
+class WorkerPool {
+public:
+    typedef std::function<void(size_t, size_t)> RangeJob;
+
+    static WorkerPool& instance();
+
+    // calls job(begin, end) for consecutive ranges of at most grain items covering [0, count).
+    // The calling thread takes ranges too; returns when all of them are done. Ranges start at
+    // multiples of grain, so SIMD kernels keep their alignment.
+    void parallelFor(size_t count, size_t grain, const RangeJob& job);
+
+    // worker threads plus the calling thread
+    size_t threadCount() const {
+        return workers.size() + 1;
+    }
+
+    ~WorkerPool();
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex callMutex;              // one parallelFor at a time
+    std::mutex mutex;                  // guards the fields below
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    const RangeJob* job = nullptr;
+    size_t jobCount = 0;
+    size_t jobGrain = 1;
+    std::atomic<size_t> nextRange;
+    unsigned int generation = 0;       // bumped for every job, workers wake on a change
+    size_t busyWorkers = 0;
+    bool stopping = false;
+
+    WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void workerLoop();
+    void runRanges();
+};
+
+#endif // WORKER_POOL_H
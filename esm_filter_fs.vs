@@ -0,0 +1,50 @@
+#version 330 core
+// One direction of the separable ESM blur over a face of the shadow cube map (ShadowFilter).
+// HORIZONTAL: reads the depth cube map, writes the blurred exp(exponent * depth) of the face
+//             into a 2D scratch texture. Taps past the face edge fall on the neighbouring face.
+// otherwise:  blurs the scratch texture vertically into the face of the ESM cube map.
+out vec4 FragColor;
+
+#ifdef HORIZONTAL
+uniform samplerCube depthMap;
+uniform int face;
+uniform float exponent;
+#else
+uniform sampler2D source;
+#endif
+uniform int size;
+
+// 5-tap binomial kernel, index by distance from the center
+const float weights[3] = float[](0.375, 0.25, 0.0625);
+
+#ifdef HORIZONTAL
+// direction of the face texel at st in [-1, 1], GL cube map face orientation
+vec3 faceDirection(vec2 st)
+{
+    if(face == 0) return vec3(1.0, -st.y, -st.x);
+    if(face == 1) return vec3(-1.0, -st.y, st.x);
+    if(face == 2) return vec3(st.x, 1.0, st.y);
+    if(face == 3) return vec3(st.x, -1.0, -st.y);
+    if(face == 4) return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+#endif
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float sum = 0.0;
+#ifdef HORIZONTAL
+    float texelSize = 2.0 / float(size);
+    vec2 st = (vec2(texel) + 0.5) * texelSize - 1.0;
+    for(int k = -2; k <= 2; ++k)
+    {
+        float depth = texture(depthMap, faceDirection(st + vec2(float(k) * texelSize, 0.0))).r;
+        sum += weights[abs(k)] * exp(exponent * depth);
+    }
+#else
+    for(int k = -2; k <= 2; ++k)
+        sum += weights[abs(k)] * texelFetch(source, ivec2(texel.x, clamp(texel.y + k, 0, size - 1)), 0).r;
+#endif
+    FragColor = vec4(sum);
+}
@@ -0,0 +1,72 @@
+#version 430 core
+// starts one shell per emission request in a slot taken from the dead list
+layout(local_size_x = 64) in;
+
+// FlameParticle and the PARTICLE_TYPE values come from flame_particle.glsl
+layout(std430, binding = 0) buffer Particles { FlameParticle particles[]; };
+layout(std430, binding = 1) readonly buffer DeadList { uint deadList[]; };
+layout(std430, binding = 2) writeonly buffer DrawList { uint drawList[]; };
+layout(std430, binding = 3) readonly buffer EmitList { uint emitList[]; };
+layout(std430, binding = 4) buffer Counters {
+    uint vertexCount;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+    int deadCount;
+    uint emitCount;
+    uint overflow;
+};
+
+// same layout as FlameCompute::FlameInstance
+struct FlameInstance {
+    vec4 origin;
+    vec4 maxVelocity;
+    vec4 minVelocity;
+};
+layout(std430, binding = 5) readonly buffer Flames { FlameInstance flames[]; };
+layout(std430, binding = 6) readonly buffer ParticleFlame { uint particleFlame[]; };
+
+uniform float MAX_LIFE;
+uniform float MIN_LIFE;
+uniform float r;
+uniform uint gFrame;
+uniform uint gSeed;
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= emitCount)
+        return;
+    uint launcher = emitList[id];
+
+    // pop a free slot; an empty dead list drops the request
+    int top = atomicAdd(deadCount, -1) - 1;
+    if (top < 0) {
+        atomicAdd(deadCount, 1);
+        atomicAdd(overflow, 1u);
+        return;
+    }
+    uint slot = deadList[top];
+
+    // the simulate pass drew from seed gSeed for this launcher, take another sequence
+    uint rng = rngInit(launcher, gFrame, gSeed + 1u);
+    FlameParticle l = particles[launcher];
+    FlameInstance flame = flames[particleFlame[launcher]];
+    // launchers are relative to their flame, the shell starts from the flame's origin
+    vec3 local = vec3(l.positionX, l.positionY, l.positionZ);
+    vec3 position = local + flame.origin.xyz;
+    FlameParticle s;
+    s.positionX = position.x; s.positionY = position.y; s.positionZ = position.z;
+    // between the flame's minimum and maximum velocity, like the launchers
+    vec3 velocity = (flame.maxVelocity.xyz - flame.minVelocity.xyz) * rngNext(rng) + flame.minVelocity.xyz;
+    float life = (MAX_LIFE - MIN_LIFE) * rngNext(rng) + MIN_LIFE;
+    // longer lives near the center of the flame
+    float dist = sqrt(local.x * local.x + local.z * local.z);
+    if (dist <= r)
+        life *= 1.3;
+    s.velocityXY = packVelocityXY(velocity);
+    s.velocityZTypeAlpha = packVelocityZTypeAlpha(velocity.z, PARTICLE_TYPE_SHELL, unpackAlpha(l.velocityZTypeAlpha));
+    s.ageLife = packAgeLife(life, life);
+    particles[slot] = s;
+    drawList[atomicAdd(vertexCount, 1u)] = slot;
+}
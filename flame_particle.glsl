@@ -0,0 +1,76 @@
+// Packed flame particle, 24 bytes instead of 44. Inserted after the #version line of every
+// flame shader (Shader::readFile passed as defines, before random.glsl) and mirrored by
+// Flame::FlameParticle:
+//   position            3 floats
+//   velocityXY          half floats, x in the low 16 bits
+//   velocityZTypeAlpha  half float z in bits 0-15, alpha as unorm14 in bits 16-29,
+//                       type in bits 30-31
+//   ageLife             age and life in milliseconds as unorm16 of FLAME_AGE_RANGE,
+//                       age in the low 16 bits
+// The point size is not stored: launchers keep FLAME_INIT_SIZE, shells follow their alpha.
+#if __VERSION__ < 420
+#extension GL_ARB_shading_language_packing : require
+#endif
+
+#define PARTICLE_TYPE_LAUNCHER 0u
+#define PARTICLE_TYPE_SHELL 1u
+#define PARTICLE_TYPE_DEAD 2u // free slot, compute path only
+#define FLAME_AGE_RANGE 1000.0
+#define FLAME_INIT_SIZE 30.0
+#define FLAME_SHELL_SIZE 55.0
+
+// storage buffer form, for the compute path
+struct FlameParticle {
+    float positionX, positionY, positionZ;
+    uint velocityXY;
+    uint velocityZTypeAlpha;
+    uint ageLife;
+};
+
+uint packVelocityXY(vec3 velocity)
+{
+    return packHalf2x16(velocity.xy);
+}
+
+uint packVelocityZTypeAlpha(float velocityZ, uint type, float alpha)
+{
+    uint a = uint(round(clamp(alpha, 0.0, 1.0) * 16383.0));
+    return (packHalf2x16(vec2(velocityZ, 0.0)) & 0xFFFFu) | (a << 16) | (type << 30);
+}
+
+vec3 unpackVelocity(uint velocityXY, uint velocityZTypeAlpha)
+{
+    return vec3(unpackHalf2x16(velocityXY), unpackHalf2x16(velocityZTypeAlpha & 0xFFFFu).x);
+}
+
+uint unpackType(uint velocityZTypeAlpha)
+{
+    return velocityZTypeAlpha >> 30;
+}
+
+float unpackAlpha(uint velocityZTypeAlpha)
+{
+    return float((velocityZTypeAlpha >> 16) & 0x3FFFu) / 16383.0;
+}
+
+// keeps velocity and alpha, replaces the type
+uint withType(uint velocityZTypeAlpha, uint type)
+{
+    return (velocityZTypeAlpha & 0x3FFFFFFFu) | (type << 30);
+}
+
+uint packAgeLife(float age, float life)
+{
+    return packUnorm2x16(vec2(age, life) / FLAME_AGE_RANGE);
+}
+
+// x: age, y: life
+vec2 unpackAgeLife(uint ageLife)
+{
+    return unpackUnorm2x16(ageLife) * FLAME_AGE_RANGE;
+}
+
+float particleSize(uint type, float alpha)
+{
+    return type == PARTICLE_TYPE_LAUNCHER ? FLAME_INIT_SIZE : FLAME_SHELL_SIZE * alpha;
+}
@@ -1,9 +1,8 @@
 #version 330 core
+// packed particle, see flame_particle.glsl; the velocity is not needed here
 layout (location = 3)in vec3 position;
-layout (location = 4)in float alpha;
-layout (location = 5)in float size;
-layout (location = 6)in float lifetimeMills;
-layout (location = 7)in float life;
+layout (location = 4)in uint velocityZTypeAlpha;
+layout (location = 5)in uint ageLife;
 
 out vec3 pos;
 out float Alpha;
@@ -15,11 +14,14 @@ uniform mat4 view;
 uniform mat4 projection;
 void main()
 {
+	float alpha = unpackAlpha(velocityZTypeAlpha);
+	float size = particleSize(unpackType(velocityZTypeAlpha), alpha);
+	vec2 age = unpackAgeLife(ageLife);
 	pos = position;
 	gl_PointSize = size;
 	gl_Position = projection * view * model * vec4(position,1.0f);
     Alpha = alpha;
-    Age = lifetimeMills;
-    Life = life;
+    Age = age.x;
+    Life = age.y;
     Size =size;
 }
@@ -0,0 +1,43 @@
+#version 430 core
+// flame_render.vs for the compute path: the live particles are fetched through the draw list.
+// Launchers are relative to their flame, shells already carry the flame's origin
+
+layout(std430, binding = 0) readonly buffer Particles { FlameParticle particles[]; };
+layout(std430, binding = 2) readonly buffer DrawList { uint drawList[]; };
+
+// same layout as FlameCompute::FlameInstance
+struct FlameInstance {
+    vec4 origin;
+    vec4 maxVelocity;
+    vec4 minVelocity;
+};
+layout(std430, binding = 5) readonly buffer Flames { FlameInstance flames[]; };
+layout(std430, binding = 6) readonly buffer ParticleFlame { uint particleFlame[]; };
+
+out vec3 pos;
+out float Alpha;
+out float Age;
+out float Life;
+out float Size;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+void main()
+{
+    uint id = drawList[gl_VertexID];
+    FlameParticle p = particles[id];
+    uint type = unpackType(p.velocityZTypeAlpha);
+    vec3 position = vec3(p.positionX, p.positionY, p.positionZ);
+    if (type == PARTICLE_TYPE_LAUNCHER)
+        position += flames[particleFlame[id]].origin.xyz;
+    float alpha = unpackAlpha(p.velocityZTypeAlpha);
+    float size = particleSize(type, alpha);
+    vec2 age = unpackAgeLife(p.ageLife);
+    pos = position;
+    gl_PointSize = size;
+    gl_Position = projection * view * model * vec4(position, 1.0f);
+    Alpha = alpha;
+    Age = age.x;
+    Life = age.y;
+    Size = size;
+}
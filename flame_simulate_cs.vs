@@ -0,0 +1,71 @@
+#version 430 core
+// in-place flame update: launchers count down and request a shell, shells age and move,
+// expired shells return their slot to the dead list; every live particle is appended to
+// the draw list
+layout(local_size_x = 256) in;
+
+// FlameParticle and the PARTICLE_TYPE values come from flame_particle.glsl
+layout(std430, binding = 0) buffer Particles { FlameParticle particles[]; };
+layout(std430, binding = 1) writeonly buffer DeadList { uint deadList[]; };
+layout(std430, binding = 2) writeonly buffer DrawList { uint drawList[]; };
+layout(std430, binding = 3) writeonly buffer EmitList { uint emitList[]; };
+layout(std430, binding = 4) buffer Counters {
+    uint vertexCount;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+    int deadCount;
+    uint emitCount;
+    uint overflow;
+};
+
+uniform float gDeltaTimeMillis;
+uniform float MAX_LIFE;
+uniform float MIN_LIFE;
+uniform int capacity;
+uniform uint gFrame;
+uniform uint gSeed;
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= uint(capacity))
+        return;
+    FlameParticle p = particles[id];
+    uint type = unpackType(p.velocityZTypeAlpha);
+    if (type == PARTICLE_TYPE_DEAD)
+        return;
+
+    vec2 ageLife = unpackAgeLife(p.ageLife);
+    float Age = ageLife.x - gDeltaTimeMillis;
+    if (type == PARTICLE_TYPE_LAUNCHER) {
+        if (Age <= 0) {
+            // the emit pass starts the shell
+            emitList[atomicAdd(emitCount, 1u)] = id;
+            uint rng = rngInit(id, gFrame, gSeed);
+            Age = (MAX_LIFE - MIN_LIFE) * rngNext(rng) + MIN_LIFE;
+        }
+        particles[id].ageLife = packAgeLife(Age, ageLife.y);
+        drawList[atomicAdd(vertexCount, 1u)] = id;
+        return;
+    }
+
+    if (Age < 0) {
+        particles[id].velocityZTypeAlpha = withType(p.velocityZTypeAlpha, PARTICLE_TYPE_DEAD);
+        deadList[atomicAdd(deadCount, 1)] = id;
+        return;
+    }
+    float DeltaTimeSecs = gDeltaTimeMillis / 1000.0f;
+    vec3 velocity = unpackVelocity(p.velocityXY, p.velocityZTypeAlpha);
+    vec3 position = vec3(p.positionX, p.positionY, p.positionZ) + velocity * DeltaTimeSecs;
+    velocity += DeltaTimeSecs * vec3(0.0, 1.0, 0.0);
+    p.positionX = position.x; p.positionY = position.y; p.positionZ = position.z;
+    // same alpha curve as the transform feedback path, the size follows from it
+    float life = ageLife.y;
+    float factor = 1.0f / ((Age / 1000.0f - life / 2000.0f) * (Age / 1000.0f - life / 2000.0f) + 1);
+    p.velocityXY = packVelocityXY(velocity);
+    p.velocityZTypeAlpha = packVelocityZTypeAlpha(velocity.z, PARTICLE_TYPE_SHELL, factor);
+    p.ageLife = packAgeLife(Age, life);
+    particles[id] = p;
+    drawList[atomicAdd(vertexCount, 1u)] = id;
+}
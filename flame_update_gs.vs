@@ -2,78 +2,60 @@
 layout (points) in;
 layout (points,max_vertices = 10) out;
 
-in float Type0[];
 in vec3 Position0[];
-in vec3 Velocity0[];
-in float Age0[];
-in float Alpha0[];
-in float Size0[];
-in float Life0[];
+flat in uint VelocityXY0[];
+flat in uint VelocityZTypeAlpha0[];
+flat in uint AgeLife0[];
 
-out float Type1;
+//Ӹʽflame_particle.glsl
 out vec3 Position1;
-out vec3 Velocity1;
-out float Age1;
-out float Alpha1;
-out float Size1;
-out float Life1;
+flat out uint VelocityXY1;
+flat out uint VelocityZTypeAlpha1;
+flat out uint AgeLife1;
 
 uniform float gDeltaTimeMillis;//ÿ֡ʱ仯
 //uniform float gTime;//ܵʱ仯
-uniform sampler1D gRandomTexture;
+uniform uint gFrame;//֡ţ
+uniform uint gSeed;//е
 uniform float MAX_LIFE;
 uniform float MIN_LIFE;
 uniform vec3 MAX_VELOC;
 uniform vec3 MIN_VELOC;
 uniform float r;
 
-#define PARTICLE_TYPE_LAUNCHER 0.0f
-#define PARTICLE_TYPE_SHELL 1.0f
-
-vec3 GetRandomDir(float TexCoord)
-{
-	vec3 Dir = texture(gRandomTexture,TexCoord).xyz;
-	Dir -= vec3(0.5,0.5,0.5);
-	return Dir;
-}
-
-vec3 Rand(float TexCoord){//0-1
-    vec3 ret = texture(gRandomTexture,TexCoord).xyz;
-    return ret; 
-}
-
 void main()
 {
-    float Age = Age0[0] - gDeltaTimeMillis;
-	if(Type0[0] == PARTICLE_TYPE_LAUNCHER){//淢
+    uint Type = unpackType(VelocityZTypeAlpha0[0]);
+    vec2 AgeLife = unpackAgeLife(AgeLife0[0]);
+    float Age = AgeLife.x - gDeltaTimeMillis;
+	if(Type == PARTICLE_TYPE_LAUNCHER){//淢
         if(Age <= 0 ){
+            //ÿÿ֡Уrandom.glsl
+            uint rng = rngInit(uint(gl_PrimitiveIDIn), gFrame, gSeed);
             //ڶ
-            Type1 = PARTICLE_TYPE_SHELL;
             Position1 = Position0[0];
             //ʼһСٶ֮
-            Velocity1 = (MAX_VELOC-MIN_VELOC)*Rand(Age0[0]).x+MIN_VELOC;
+            vec3 Velocity = (MAX_VELOC-MIN_VELOC)*rngNext(rng)+MIN_VELOC;
 			//ͬ
-            Age1 = (MAX_LIFE-MIN_LIFE)*Rand(Age0[0]).y + MIN_LIFE;
+            float Life = (MAX_LIFE-MIN_LIFE)*rngNext(rng) + MIN_LIFE;
 			//ǰӵԲĵľ룬Ĭԭ
             float dist = sqrt(Position1.x*Position1.x + Position1.z*Position1.z);
 			//ĳһ㣬Ե̣ԵĵľΪ׼
 			//rΪİ뾶
-			if(dist <= r)Age1 *= 1.3;
-			//Age1 *= (1 + r/dist);
-            Life1 = Age1;
-            Alpha1 = Alpha0[0];
-            Size1 = Size0[0];
+			if(dist <= r)Life *= 1.3;
+			//Life *= (1 + r/dist);
+            VelocityXY1 = packVelocityXY(Velocity);
+            VelocityZTypeAlpha1 = packVelocityZTypeAlpha(Velocity.z, PARTICLE_TYPE_SHELL, unpackAlpha(VelocityZTypeAlpha0[0]));
+            AgeLife1 = packAgeLife(Life, Life);
             EmitVertex();
             EndPrimitive();
-            Age = (MAX_LIFE-MIN_LIFE)*Rand(Age0[0]).z + MIN_LIFE;
+            Age = (MAX_LIFE-MIN_LIFE)*rngNext(rng) + MIN_LIFE;
         }
-        Type1 = PARTICLE_TYPE_LAUNCHER;
+        //ֻ仯ԭ
         Position1 = Position0[0];
-        Velocity1 = Velocity0[0];
-        Age1 = Age;
-        Alpha1 = Alpha0[0];
-        Size1 = Size0[0];
-        Life1 = Life0[0];
+        VelocityXY1 = VelocityXY0[0];
+        VelocityZTypeAlpha1 = VelocityZTypeAlpha0[0];
+        AgeLife1 = packAgeLife(Age, AgeLife.y);
         EmitVertex();
         EndPrimitive();
       }
@@ -81,20 +63,20 @@ void main()
         if(Age >= 0){
 			//ʱתΪΪλ
             float DeltaTimeSecs = gDeltaTimeMillis/1000.0f;
+            vec3 Velocity = unpackVelocity(VelocityXY0[0], VelocityZTypeAlpha0[0]);
 			//λõı仯δٶ
-            vec3 DeltaP = Velocity0[0]*DeltaTimeSecs;
+            vec3 DeltaP = Velocity*DeltaTimeSecs;
 			vec3 DeltaV = DeltaTimeSecs*vec3(0.0,1.0,0.0);
-            Type1 = PARTICLE_TYPE_SHELL;
             Position1 = Position0[0] + DeltaP;
-            Velocity1 = Velocity0[0] + DeltaV;
-            Age1 = Age;
-            Life1 = Life0[0];
+            Velocity += DeltaV;
+            float Life = AgeLife.y;
             //УһʼȽСȻּС
-            //õǰʣȫôСalpha,ʵǳֲ̫мС
-            float factor = 1.0f/((Age/1000.0f - Life1/2000.0f)*(Age/1000.0f - Life1/2000.0f)+1);
-            Alpha1 = factor;
-            //ıӵĴС
-            Size1 = 55.0*factor;
+            //õǰʣȫalpha,ʵǳֲ̫мС
+            //ӴСalphaparticleSizeٵ
+            float factor = 1.0f/((Age/1000.0f - Life/2000.0f)*(Age/1000.0f - Life/2000.0f)+1);
+            VelocityXY1 = packVelocityXY(Velocity);
+            VelocityZTypeAlpha1 = packVelocityZTypeAlpha(Velocity.z, PARTICLE_TYPE_SHELL, factor);
+            AgeLife1 = packAgeLife(Age, Life);
             EmitVertex();
             EndPrimitive();
         }
@@ -1,5 +1,6 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aLight; // per instance: xyz center, w radius
 
 out VS_OUT {
     vec2 texCoords;
@@ -15,5 +16,7 @@ uniform mat4 projection;
 
 void main()
 {  
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    // aPos is on the unit hemisphere
+    vec3 worldPos = aLight.xyz + aPos * aLight.w;
+    gl_Position = projection * view * model * vec4(worldPos, 1.0);
 }
@@ -3,6 +3,7 @@
 #include <GLFW/glfw3.h>
 #include "stb_image.h"
 #include <vector>
+#include <algorithm>
 #include <cstdlib> // rand()srand()
 #include <ctime> // time()
 
@@ -16,30 +17,50 @@
 #include "Model.h"
 #include "Room.h"
 #include "ParticleGenerator.h"
+#include "Flame.h"
+#include "FlameManager.h"
 #include "Light.h"
 #include "Ball.h"
+#include "BallRenderer.h"
+#include "BallGrid.h"
+#include "BallSystem.h"
+#include "Benchmark.h"
+#include "SimulationClock.h"
+#include "TextureCache.h"
+#include "WorkerPool.h"
+#include "GpuProfiler.h"
+#include "ShadowCache.h"
+#include "ShadowCulling.h"
+#include "ShadowFilter.h"
+#include "ParaboloidShadow.h"
+#include "CpuProfiler.h"
 
 #include <iostream>
+#include <functional>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int loadTexture(const char* path);
 void renderScene(const Shader& shader);
 void renderCube();
-void collision_detection(Ball& ball, Model& model);
+void collision_detection(BallSystem& balls, size_t ball, Model& model);
 bool testSphereTriangle(const glm::vec3& center, float radius, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3, const glm::vec3& mesh_normal);
-bool testSphereTriangle_test(const glm::vec3& center, float radius, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3, const glm::vec3& mesh_normal, Ball &ball);
+bool testSphereTriangle_test(const glm::vec3& center, float radius, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3, const glm::vec3& mesh_normal);
 glm::vec3 reflectVec3(glm::vec3 A, glm::vec3 B);
 void reflectVec3_modified(glm::vec3& A, glm::vec3& B, const glm::vec3& norm);
 void generateRandomBalls(int numBalls);
-void collision_detection_wall(Ball& ball, Room &room);
+void collision_detection_wall(BallSystem& balls, size_t ball, Room &room);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
 void dragModel();
 void collision_detection_fire();
 void generateFire();
+void simulationStep(float dt, Room& room, Flame::FlameManager* flames);
+void benchmarkBallCollisions();
+void benchmarkParticleUpdate();
+void benchmarkFlame();
 
 ParticleGenerator *particleGenerator;
 // Initialize EmitterState with start position, velocity, and dampening
@@ -51,6 +72,12 @@ const unsigned int SCR_WIDTH = 2000;
 const unsigned int SCR_HEIGHT = 1500;
 bool shadows = true;
 bool shadowsKeyPressed = false;
+bool shadowCulling = true; // casters drawn only into the cube map faces they touch
+bool shadowCullingKeyPressed = false;
+ShadowQuality shadowQuality = SHADOW_PCF20; // filtering tier of the lighting shader
+bool shadowQualityKeyPressed = false;
+PointShadowBackend pointShadowBackend = POINT_SHADOW_CUBE;
+bool pointShadowBackendKeyPressed = false;
 glm::mat4 projection;
 glm::mat4 view;
 glm::vec3 newMousePoint;
@@ -58,6 +85,7 @@ glm::vec3 lastMousePoint;
 bool isDragging = false;
 bool isBallsGenerated = false;
 bool isFireGenerated = false;
+unsigned int ballSeed = 0; // 0 seeds generateRandomBalls from time()
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 25.0f));
@@ -68,10 +96,16 @@ bool firstMouse = true;
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+// physics runs at a fixed rate, rendering interpolates between the last two steps
+SimulationClock simClock(120.0f);
+
+// per-pass GPU timings; in benchmark mode every sample is written to gpu_passes.csv on exit
+GpuProfiler gpuProfiler;
 
 int moving_tumbler = 0;
 std::vector<Model> tumblers;
-std::vector<Ball> balls;
+BallSystem balls;
+BallGrid ballGrid(roomWidth, roomHeight, roomDepth); // broad phase for ball-ball collisions
 const float m_ball = 1.0f;
 const float m_tumbler = 5.0f;
 const float e = 0.9;
@@ -82,46 +116,111 @@ const float speedLimit = 15.0f;
 const float ballRadius = 0.5f;
 const int ballCount = 30;
 const float examBorder = 2.0f;
-const int particleCount = 200;
+int particleCount = 200; // fire particles in the pool and emitted per step
+ParticleBackend particleBackend = PARTICLES_CPU;
+bool particleBackendKeyPressed = false;
+int flameCount = 8; // flames in a ring on the floor
 
-int main()
+int main(int argc, char* argv[])
 {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // --benchmark renders a fixed number of frames offscreen and reports frame timings
+    BenchmarkOptions bench = parseBenchmarkArgs(argc, argv);
+    if (bench.collisionScaling)
+    {
+        // CPU only, no GL context needed
+        benchmarkBallCollisions();
+        return 0;
+    }
+    if (bench.particleScaling)
+    {
+        benchmarkParticleUpdate();
+        return 0;
+    }
+    if (bench.particles > 0)
+        particleCount = bench.particles;
+    if (bench.computeParticles)
+        particleBackend = PARTICLES_COMPUTE;
+    if (bench.flames >= 0)
+        flameCount = bench.flames;
+    shadowCulling = bench.shadowCulling;
+    shadowQuality = parseShadowQuality(bench.shadowQuality, shadowQuality);
+    if (bench.paraboloidShadows)
+        pointShadowBackend = POINT_SHADOW_PARABOLOID;
+    gpuProfiler.setRecordHistory(bench.enabled);
+    GLFWwindow* window = NULL;
+    // benchmarks render offscreen, the window only provides the context
+    bool offscreen = bench.enabled || bench.flameScaling;
+
+#ifdef HEADLESS_EGL
+    // headless: EGL surfaceless context (Mesa llvmpipe works), no window system needed
+    HeadlessContext headless;
+    bool useHeadless = offscreen && headless.create();
+    if (useHeadless && !gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        headless.destroy();
+        return -1;
+    }
+#else
+    bool useHeadless = false;
+#endif
+
+    if (!useHeadless)
+    {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        if (offscreen)
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        // glfwSetCursorPosCallback(window, mouse_callback);
+        // glfwSetScrollCallback(window, scroll_callback);
+        glfwSetCursorPosCallback(window, cursor_position_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+
+        // tell GLFW to capture our mouse
+        // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    // glfwSetCursorPosCallback(window, mouse_callback);
-    // glfwSetScrollCallback(window, scroll_callback);
-    glfwSetCursorPosCallback(window, cursor_position_callback);
-    glfwSetMouseButtonCallback(window, mouse_button_callback);
-
-    // tell GLFW to capture our mouse
-    // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (bench.flameScaling)
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // only the flame, no scene
+        benchmarkFlame();
+#ifdef HEADLESS_EGL
+        if (useHeadless)
+        {
+            headless.destroy();
+            return 0;
+        }
+#endif
+        glfwTerminate();
+        return 0;
     }
 
     // configure global opengl state
@@ -131,12 +230,28 @@ int main()
 
     // build and compile shaders
     // -------------------------
-    Shader shader("3.2.2.point_shadows.vs", "3.2.2.point_shadows.fs");
     Shader simpleDepthShader("3.2.2.point_shadows_depth.vs", "3.2.2.point_shadows_depth.fs", "3.2.2.point_shadows_depth.gs");
     Shader particleShader("particle.vs", "particle_fs.vs");
     Shader lightShader("light.vs", "light.fs");
-    // Shader ballDepthShader("ball_depth.vs", "3.2.2.point_shadows_depth.fs", "3.2.2.point_shadows_depth.gs");
-    // Shader ballShader("ball.vs", "3.2.2.point_shadows.fs");
+    // instanced variants for the balls: per-instance center/radius and a texture array layer
+    Shader ballDepthShader("3.2.2.point_shadows_depth.vs", "3.2.2.point_shadows_depth.fs", "3.2.2.point_shadows_depth.gs", "#define INSTANCED_BALLS\n");
+    // lighting shaders, one variant per shadow filtering tier
+    std::vector<Shader> sceneShaders, ballShaders;
+    for (int q = 0; q < SHADOW_QUALITY_COUNT; ++q) {
+        std::string defines = shadowQualityDefines((ShadowQuality)q);
+        sceneShaders.push_back(Shader("3.2.2.point_shadows.vs", "3.2.2.point_shadows.fs", nullptr, defines));
+        ballShaders.push_back(Shader("3.2.2.point_shadows.vs", "3.2.2.point_shadows.fs", nullptr, defines + "#define INSTANCED_BALLS\n"));
+    }
+    // one cube map face per draw, for the casters culled per face
+    Shader faceDepthShader("3.2.2.point_shadows_depth.vs", "3.2.2.point_shadows_depth.fs", nullptr, "#define SINGLE_FACE\n");
+    Shader ballFaceDepthShader("3.2.2.point_shadows_depth.vs", "3.2.2.point_shadows_depth.fs", nullptr, "#define SINGLE_FACE\n#define INSTANCED_BALLS\n");
+    // dual-paraboloid backend: vertex shader warp into one hemisphere per draw, and its lighting
+    Shader paraboloidDepthShader("3.2.2.point_shadows_depth.vs", "3.2.2.point_shadows_depth.fs", nullptr, "#define PARABOLOID\n");
+    Shader ballParaboloidDepthShader("3.2.2.point_shadows_depth.vs", "3.2.2.point_shadows_depth.fs", nullptr, "#define PARABOLOID\n#define INSTANCED_BALLS\n");
+    Shader paraboloidShader("3.2.2.point_shadows.vs", "3.2.2.point_shadows.fs", nullptr, "#define PARABOLOID\n");
+    Shader ballParaboloidShader("3.2.2.point_shadows.vs", "3.2.2.point_shadows.fs", nullptr, "#define PARABOLOID\n#define INSTANCED_BALLS\n");
+    BallRenderer ballRenderer;
+    ballRenderer.init();
     std::vector<const char*> texturePaths = {
     "./texture/glass.jpg",
     "./texture/wall_blue_2.jpeg",
@@ -145,13 +260,35 @@ int main()
     "./floor.jpg",
     "./wall.png",
     };
-    // Flame::Flame flame;
+    // start decoding every texture the scene needs on the worker threads; the loaders below only
+    // wait for images that are not decoded yet, and spawning balls or fire later finds them uploaded
+    TextureCache& textureCache = TextureCache::instance();
+    for (const char* path : texturePaths)
+        textureCache.prefetch(path);
+    textureCache.prefetch("./texture.jpg", TextureSampler::clampingAlpha());
+    textureCache.prefetch("./texture/ball_white.jpg");
+    textureCache.prefetch("./texture/fire.jpg");
+    // flames in a ring on the floor, all of them updated and drawn by one FlameManager
+    std::unique_ptr<Flame::FlameManager> flames;
+    if (Flame::FlameManager::supported()) {
+        flames.reset(new Flame::FlameManager());
+        for (int i = 0; i < flameCount; ++i) {
+            float angle = 6.2831853f * i / flameCount;
+            flames->add(glm::vec3(8.0f * std::cos(angle), -roomHeight / 2.0f + 0.1f, 8.0f * std::sin(angle)), glm::vec3(0.0f, -0.5f, 0.0f));
+        }
+    }
+    else if (flameCount > 0) {
+        std::cout << "Flames need OpenGL 4.3, the scene has none" << std::endl;
+    }
     Room room(roomWidth, roomHeight, roomDepth, texturePaths);
     // lighting info
 // -------------
     glm::vec3 lightPos(0.0f, roomHeight / 2.0f - 0.5f, 0.0f);
 
-    Light light(lightPos, 2.0f);
+    std::vector<Light> lights;
+    lights.emplace_back(lightPos, 2.0f);
+    LightBatch lightBatch;
+    lightBatch.build(lights);
 
     // List of offsets for each tumbler
     std::vector<glm::vec3> offsets = {
@@ -175,57 +312,55 @@ int main()
 
     // load textures
     // -------------
-    unsigned int woodTexture = loadTexture("./texture.jpg");
+    unsigned int woodTexture = textureCache.load("./texture.jpg", TextureSampler::clampingAlpha());
 
-    // configure depth map FBO
+    // configure depth cubemaps: a cached layer for the static casters and the one sampled
+    // by the lighting pass
     // -----------------------
     const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-    unsigned int depthMapFBO;
-    glGenFramebuffers(1, &depthMapFBO);
-    // create depth cubemap texture
-    unsigned int depthCubemap;
-    glGenTextures(1, &depthCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-    for (unsigned int i = 0; i < 6; ++i)
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    // attach depth texture as FBO's depth buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    ShadowCache shadowCache;
+    shadowCache.init(SHADOW_WIDTH);
+    // blurred exponential shadow map for SHADOW_ESM
+    ShadowFilter shadowFilter;
+    shadowFilter.init(SHADOW_WIDTH);
+    // the dual-paraboloid alternative, same resolution per hemisphere as per cube face
+    ParaboloidShadow paraboloidShadow;
+    paraboloidShadow.init(SHADOW_WIDTH);
 
 
 
     // shader configuration
     // --------------------
-    shader.use();
-    shader.setInt("diffuseTexture", 0);
-    shader.setInt("depthMap", 1);
-
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window))
+    for (int q = 0; q < SHADOW_QUALITY_COUNT; ++q) {
+        sceneShaders[q].use();
+        sceneShaders[q].setInt("diffuseTexture", 0);
+        sceneShaders[q].setInt("depthMap", 1);
+        sceneShaders[q].setFloat("esmExponent", ShadowFilter::EXPONENT);
+        ballShaders[q].use();
+        ballShaders[q].setInt("diffuseTextures", 0);
+        ballShaders[q].setInt("depthMap", 1);
+        ballShaders[q].setFloat("esmExponent", ShadowFilter::EXPONENT);
+    }
+    paraboloidShader.use();
+    paraboloidShader.setInt("diffuseTexture", 0);
+    paraboloidShader.setInt("depthMap", 1);
+    ballParaboloidShader.use();
+    ballParaboloidShader.setInt("diffuseTextures", 0);
+    ballParaboloidShader.setInt("depthMap", 1);
+
+    // renders one frame of the scene into targetFBO (0 is the window's default framebuffer).
+    // the interactive loop and the benchmark share this so they measure the same work.
+    // ------------------------------------------------------------------------------------
+    bool esmCurrent = false; // the ESM cube map was updated last frame
+    auto renderFrame = [&](unsigned int targetFBO)
     {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-        // move light position over time
-        // lightPos.z = static_cast<float>(sin(glfwGetTime() * 0.5) * 3.0);
-        // Update ParticleGenerator
-       
+        PROFILE_SCOPE("renderFrame");
+        textureCache.update();
+        float alpha = simClock.alpha();
+        if (isBallsGenerated)
+            ballRenderer.update(balls, alpha);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
         // render
         // ------
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -247,37 +382,192 @@ int main()
 
         // 1. render scene to depth cubemap
         // --------------------------------
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        simpleDepthShader.use();
-        for (unsigned int i = 0; i < 6; ++i)
-            simpleDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-        simpleDepthShader.setFloat("far_plane", far_plane);
-        simpleDepthShader.setVec3("lightPos", lightPos);
-        shader.setVec3("displacement", glm::vec3(0.0f, 0.0f, 0.0f));
-        renderScene(simpleDepthShader);
-        room.Draw(simpleDepthShader);
-        for (auto it = tumblers.begin(); it != tumblers.end(); ++it) {
-            it->updateWobbling(deltaTime);
-            it->Draw(simpleDepthShader);
+        // the room and the tumblers at rest go to the cached static layer, which is only
+        // rendered again when one of them is dragged or starts wobbling
+        std::vector<glm::mat4> staticCasters(tumblers.size(), glm::mat4(0.0f));
+        for (size_t i = 0; i < tumblers.size(); ++i) {
+            if (tumblers[i].isAtRest())
+                staticCasters[i] = tumblers[i].modelMatrix;
         }
-        // std::cout << "ǰʱ䣺currentTime " << currentFrame;
-        // ball.applyPhysics(deltaTime);
-        // ball.draw(simpleDepthShader);
+        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+        Shader& depthShader = shadowCulling ? faceDepthShader : simpleDepthShader;
+        Shader& ballsDepthShader = shadowCulling ? ballFaceDepthShader : ballDepthShader;
+        depthShader.use();
+        depthShader.setFloat("far_plane", far_plane);
+        depthShader.setVec3("lightPos", lightPos);
+        depthShader.setVec3("displacement", glm::vec3(0.0f, 0.0f, 0.0f));
         if (isBallsGenerated) {
-            for (int i = 0; i < ballCount; i++) {
-                balls[i].applyPhysics(deltaTime);
-                balls[i].draw(simpleDepthShader);
+            ballsDepthShader.use();
+            ballsDepthShader.setFloat("far_plane", far_plane);
+            ballsDepthShader.setVec3("lightPos", lightPos);
+        }
+        if (!shadowCulling) {
+            // the geometry shader draws every triangle into all six faces
+            simpleDepthShader.use();
+            for (unsigned int i = 0; i < 6; ++i)
+                simpleDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+            if (isBallsGenerated) {
+                ballDepthShader.use();
+                for (unsigned int i = 0; i < 6; ++i)
+                    ballDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+            }
+        }
+        CubeFaceCuller shadowCuller;
+        shadowCuller.setLight(lightPos, far_plane);
+
+        // draws the static casters (room, tumblers at rest) or the dynamic ones (moving tumblers,
+        // balls) into the layer shadowCache has bound; returns the faces that got any caster
+        auto drawShadowCasters = [&](bool staticLayer) -> unsigned int
+        {
+            if (!shadowCulling) {
+                bool anyCaster = staticLayer || (isBallsGenerated && !balls.empty());
+                simpleDepthShader.use();
+                if (staticLayer) {
+                    renderScene(simpleDepthShader);
+                    room.Draw(simpleDepthShader);
+                }
+                for (size_t i = 0; i < tumblers.size(); ++i) {
+                    if (tumblers[i].isAtRest() == staticLayer) {
+                        tumblers[i].Draw(simpleDepthShader, alpha);
+                        anyCaster = true;
+                    }
+                }
+                if (!staticLayer && isBallsGenerated) {
+                    ballDepthShader.use();
+                    ballRenderer.drawDepth();
+                }
+                return anyCaster ? CubeFaceCuller::ALL_FACES : 0u;
+            }
+
+            // the faces every caster touches, then one pass per face
+            unsigned int wallFaces[6] = { 0, 0, 0, 0, 0, 0 };
+            std::vector<unsigned int> tumblerFaces(tumblers.size(), 0);
+            {
+                PROFILE_SCOPE("shadow culling");
+                if (staticLayer) {
+                    for (int w = 0; w < 6; ++w)
+                        wallFaces[w] = shadowCuller.boxFaces(room.wallMin(w), room.wallMax(w));
+                }
+                for (size_t i = 0; i < tumblers.size(); ++i) {
+                    if (tumblers[i].isAtRest() == staticLayer)
+                        tumblerFaces[i] = shadowCuller.boxFaces(tumblers[i].asset->bboxMin, tumblers[i].asset->bboxMax, tumblers[i].drawMatrix(alpha));
+                }
+                if (!staticLayer && isBallsGenerated)
+                    ballRenderer.cullDepth(shadowCuller);
+            }
+            unsigned int faces = 0;
+            for (int w = 0; w < 6; ++w)
+                faces |= wallFaces[w];
+            for (size_t i = 0; i < tumblers.size(); ++i)
+                faces |= tumblerFaces[i];
+            if (!staticLayer && isBallsGenerated)
+                faces |= ballRenderer.depthFaces();
+            faceDepthShader.use();
+            if (staticLayer)
+                renderScene(faceDepthShader);
+            for (int face = 0; face < 6; ++face) {
+                unsigned int bit = 1u << face;
+                shadowCache.bindFace(face);
+                faceDepthShader.use();
+                faceDepthShader.setMat4("shadowMatrix", shadowTransforms[face]);
+                for (int w = 0; w < 6; ++w) {
+                    if (wallFaces[w] & bit)
+                        room.drawWall(faceDepthShader, w);
+                }
+                for (size_t i = 0; i < tumblers.size(); ++i) {
+                    if (tumblerFaces[i] & bit)
+                        tumblers[i].Draw(faceDepthShader, alpha);
+                }
+                if (!staticLayer && isBallsGenerated) {
+                    ballFaceDepthShader.use();
+                    ballFaceDepthShader.setMat4("shadowMatrix", shadowTransforms[face]);
+                    ballRenderer.drawDepthFace(face);
+                }
+            }
+            return faces;
+        };
+
+        // dual-paraboloid: every caster but the room, into the hemispheres its bounds reach
+        auto drawParaboloidCasters = [&]()
+        {
+            std::vector<unsigned int> tumblerHemispheres(tumblers.size(), 0);
+            for (size_t i = 0; i < tumblers.size(); ++i) {
+                glm::vec3 boxMin, boxMax;
+                transformBox(tumblers[i].asset->bboxMin, tumblers[i].asset->bboxMax, tumblers[i].drawMatrix(alpha), boxMin, boxMax);
+                tumblerHemispheres[i] = ParaboloidShadow::boxHemispheres(lightPos, boxMin, boxMax);
+            }
+            unsigned int ballHemispheres = 0;
+            if (isBallsGenerated && !balls.empty())
+                ballHemispheres = ParaboloidShadow::boxHemispheres(lightPos, ballRenderer.getBoundsMin(), ballRenderer.getBoundsMax());
+
+            paraboloidDepthShader.use();
+            paraboloidDepthShader.setFloat("far_plane", far_plane);
+            paraboloidDepthShader.setVec3("lightPos", lightPos);
+            paraboloidDepthShader.setVec3("displacement", glm::vec3(0.0f, 0.0f, 0.0f));
+            if (ballHemispheres) {
+                ballParaboloidDepthShader.use();
+                ballParaboloidDepthShader.setFloat("far_plane", far_plane);
+                ballParaboloidDepthShader.setVec3("lightPos", lightPos);
+            }
+            glEnable(GL_CLIP_DISTANCE0);
+            for (unsigned int h = 0; h < 2; ++h) {
+                unsigned int bit = 1u << h;
+                paraboloidShadow.begin(h);
+                paraboloidDepthShader.use();
+                paraboloidDepthShader.setFloat("hemisphere", ParaboloidShadow::axis(h));
+                for (size_t i = 0; i < tumblers.size(); ++i) {
+                    if (tumblerHemispheres[i] & bit)
+                        tumblers[i].Draw(paraboloidDepthShader, alpha);
+                }
+                if (ballHemispheres & bit) {
+                    ballParaboloidDepthShader.use();
+                    ballParaboloidDepthShader.setFloat("hemisphere", ParaboloidShadow::axis(h));
+                    ballRenderer.drawDepth();
+                }
+            }
+            glDisable(GL_CLIP_DISTANCE0);
+        };
+
+        bool cubeShadows = pointShadowBackend == POINT_SHADOW_CUBE;
+        if (cubeShadows) {
+            if (shadowCache.updateStatic(staticCasters)) {
+                gpuProfiler.beginPass("shadow_static", true);
+                shadowCache.beginStatic();
+                drawShadowCasters(true);
+                gpuProfiler.endPass();
+            }
+
+            // dynamic casters on top of a copy of the static layer
+            gpuProfiler.beginPass("shadow", true);
+            shadowCache.beginDynamic();
+            unsigned int dynamicFaces = drawShadowCasters(false);
+            gpuProfiler.endPass();
+
+            // ESM: blur the faces that changed
+            if (shadowQuality == SHADOW_ESM) {
+                if (!esmCurrent)
+                    shadowFilter.invalidate();
+                gpuProfiler.beginPass("shadow_filter");
+                shadowFilter.update(shadowCache, dynamicFaces);
+                gpuProfiler.endPass();
             }
         }
+        else {
+            gpuProfiler.beginPass("shadow", true);
+            drawParaboloidCasters();
+            gpuProfiler.endPass();
+        }
+        esmCurrent = cubeShadows && shadowQuality == SHADOW_ESM;
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
 
         // 2. render scene as normal 
         // -------------------------
+        gpuProfiler.beginPass("main");
         glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        Shader& shader = cubeShadows ? sceneShaders[shadowQuality] : paraboloidShader;
+        Shader& ballShader = cubeShadows ? ballShaders[shadowQuality] : ballParaboloidShader;
         shader.use();
         projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         view = camera.GetViewMatrix();
@@ -292,57 +582,179 @@ int main()
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, woodTexture);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+        if (cubeShadows) {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, shadowQuality == SHADOW_ESM ? shadowFilter.cubemap() : shadowCache.cubemap());
+            glBindSampler(1, shadowCache.sampler(shadowQuality));
+        }
+        else {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, paraboloidShadow.texture());
+        }
         renderScene(shader);
         room.Draw(shader);
         for (auto it = tumblers.begin(); it != tumblers.end(); ++it) {
-            it->Draw(shader);
+            it->Draw(shader, alpha);
         }
         // ball.draw(shader);
         if (isBallsGenerated) {
-            for (int i = 0; i < ballCount; i++) {
-                balls[i].draw(shader);
-            }
+            ballShader.use();
+            ballShader.setMat4("projection", projection);
+            ballShader.setMat4("view", view);
+            ballShader.setVec3("lightPos", lightPos);
+            ballShader.setVec3("viewPos", camera.Position);
+            ballShader.setInt("shadows", shadows);
+            ballShader.setFloat("far_plane", far_plane);
+            ballRenderer.draw(ballShader);
         }
+        glBindSampler(1, 0);
+        gpuProfiler.endPass();
 
         if (isFireGenerated) {
-            collision_detection_fire();
-            particleGenerator->Update(deltaTime, *emitterState, particleCount, glm::vec3(0.0f));
             particleShader.use();
             particleShader.setMat4("projection", projection);
             particleShader.setMat4("model", glm::mat4(1.0f)); // Replace with your actual model matrix
             particleShader.setMat4("view", view);
+            gpuProfiler.beginPass("particles");
             particleGenerator->Draw(particleShader);
+            gpuProfiler.endPass();
         }
 
         lightShader.use();
-        lightShader.setVec3("aPos", lightPos);
         lightShader.setMat4("model", glm::mat4(1.0f)); // Replace with your actual model matrix
         lightShader.setMat4("view", view); // Replace with your actual view matrix
         lightShader.setMat4("projection", projection); // Replace with your actual projection matrix
         // add time component to geometry shader in the form of a uniform
-        light.draw();
+        gpuProfiler.beginPass("light");
+        lightBatch.draw();
+        gpuProfiler.endPass();
+
+        if (flames) {
+            gpuProfiler.beginPass("flame");
+            flames->Render(view, projection);
+            gpuProfiler.endPass();
+        }
 
-        if (isBallsGenerated) {
-            for (int i = 0; i < ballCount; i++) {
-                if (balls[i].isActive()) {
-                    collision_detection_wall(balls[i], room);
-                    if (balls[i].getPosition().y >= examBorder) continue;
-                    for (auto it = tumblers.begin(); it != tumblers.end(); ++it) {
-                        collision_detection(balls[i], *it);
-                    }
-                }
+        gpuProfiler.endFrame();
+    };
+
+    if (bench.enabled)
+    {
+        // benchmark: fixed number of frames into an offscreen FBO with the full scene active
+        // -----------------------------------------------------------------------------------
+        OffscreenTarget target;
+        target.create(SCR_WIDTH, SCR_HEIGHT);
+        ballSeed = 1;
+        generateRandomBalls(bench.balls > 0 ? bench.balls : ballCount);
+        isBallsGenerated = true;
+        generateFire();
+
+        deltaTime = bench.frameDelta;
+        // warmup frames, then recorded ones when a timer is given
+        auto runFrames = [&](int count, FrameTimer* timer)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                if (timer)
+                    timer->beginFrame();
+                int steps = simClock.advance(deltaTime);
+                for (int s = 0; s < steps; ++s)
+                    simulationStep(simClock.step(), room, flames.get());
+                renderFrame(target.FBO);
+                if (timer)
+                    timer->endFrame();
+            }
+        };
+
+        if (bench.shadowTiers)
+        {
+            // every filtering tier of the cube map in turn on the running scene, then the
+            // dual-paraboloid map; the shadow passes build the map, the main pass holds the
+            // lookups, the frame time shows what is left of the difference
+            std::cout << "shadow_map,shadow_quality,shadow_gpu_ms,main_gpu_ms,frame_gpu_ms,frame_cpu_ms" << std::endl;
+            for (int q = 0; q <= SHADOW_QUALITY_COUNT; ++q)
+            {
+                bool paraboloid = q == SHADOW_QUALITY_COUNT;
+                pointShadowBackend = paraboloid ? POINT_SHADOW_PARABOLOID : POINT_SHADOW_CUBE;
+                if (!paraboloid)
+                    shadowQuality = (ShadowQuality)q;
+                runFrames(bench.warmup, nullptr);
+                gpuProfiler.resetAverages();
+                FrameTimer timer;
+                timer.init();
+                runFrames(bench.frames, &timer);
+                timer.finish();
+                gpuProfiler.endFrame();
+                double shadowMs = gpuProfiler.average("shadow_static") + gpuProfiler.average("shadow") + gpuProfiler.average("shadow_filter");
+                // the paraboloid lookup is a single compare tap whatever the tier
+                std::cout << (paraboloid ? "paraboloid" : "cube") << "," << (paraboloid ? "hard" : shadowQualityName(shadowQuality))
+                    << "," << shadowMs << "," << gpuProfiler.average("main") << ","
+                    << timer.averageGpu() << "," << timer.averageCpu() << std::endl;
             }
         }
+        else
+        {
+            runFrames(bench.warmup, nullptr);
+            FrameTimer timer;
+            timer.init();
+            runFrames(bench.frames, &timer);
+            timer.finish();
+            timer.report(std::cout);
+            if (!bench.csvPath.empty())
+                timer.writeCSV(bench.csvPath);
+        }
+        target.destroy();
+    }
+    else
+    {
+        // render loop
+        // -----------
+        while (!glfwWindowShouldClose(window))
+        {
+            // per-frame time logic
+            // --------------------
+            float currentFrame = static_cast<float>(glfwGetTime());
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            // input
+            // -----
+            processInput(window);
+
+            // simulation: as many fixed steps as the elapsed time covers
+            // ----------------------------------------------------------
+            int steps = simClock.advance(deltaTime);
+            for (int s = 0; s < steps; ++s)
+                simulationStep(simClock.step(), room, flames.get());
+
+            renderFrame(0);
+
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+    }
 
-        // flame.Render(deltaTime, view, projection);
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    gpuProfiler.report(std::cout);
+    std::cout << "Shadow cache: static layer rendered " << shadowCache.staticRenderCount() << " times" << std::endl;
+    std::cout << "Shadow casters: " << (shadowCulling ? "culled per cube map face" : "geometry shader, all faces")
+        << ", filtering: " << shadowQualityName(shadowQuality)
+        << ", map: " << (pointShadowBackend == POINT_SHADOW_CUBE ? "cube" : "dual paraboloid") << std::endl;
+    if (isFireGenerated) {
+        const ParticleStats& particleStats = particleGenerator->getStats();
+        std::cout << "Particles (" << (particleGenerator->getBackend() == PARTICLES_COMPUTE ? "compute" : "cpu") << "): "<< particleStats.alive << " alive, " << particleStats.spawned << " spawned, "
+            << particleStats.overflowed << " dropped (pool of " << particleCount + ParticleGenerator::SPARK_RESERVE << ")" << std::endl;
     }
+    if (bench.enabled)
+        gpuProfiler.writeCSV("gpu_passes.csv");
+    PROFILE_WRITE_TRACE("cpu_trace.json");
 
+#ifdef HEADLESS_EGL
+    if (useHeadless)
+    {
+        headless.destroy();
+        return 0;
+    }
+#endif
     glfwTerminate();
     return 0;
 }
@@ -391,6 +803,57 @@ void processInput(GLFWwindow* window)
     {
         shadowsKeyPressed = false;
     }
+
+    // Q cycles through the shadow filtering tiers
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS && !shadowQualityKeyPressed)
+    {
+        shadowQuality = (ShadowQuality)((shadowQuality + 1) % SHADOW_QUALITY_COUNT);
+        std::cout << "Shadow quality: " << shadowQualityName(shadowQuality) << std::endl;
+        shadowQualityKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_RELEASE)
+    {
+        shadowQualityKeyPressed = false;
+    }
+
+    // P switches the point light shadow between the cube map and the dual-paraboloid map
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !pointShadowBackendKeyPressed)
+    {
+        pointShadowBackend = pointShadowBackend == POINT_SHADOW_CUBE ? POINT_SHADOW_PARABOLOID : POINT_SHADOW_CUBE;
+        std::cout << "Point shadow: " << (pointShadowBackend == POINT_SHADOW_CUBE ? "cube map" : "dual paraboloid") << std::endl;
+        pointShadowBackendKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+    {
+        pointShadowBackendKeyPressed = false;
+    }
+
+    // C switches the shadow pass between per-face culling and the geometry shader
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !shadowCullingKeyPressed)
+    {
+        shadowCulling = !shadowCulling;
+        shadowCullingKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        shadowCullingKeyPressed = false;
+    }
+
+    // G switches the fire particles between the CPU and the compute shader backend
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !particleBackendKeyPressed)
+    {
+        particleBackend = particleBackend == PARTICLES_CPU ? PARTICLES_COMPUTE : PARTICLES_CPU;
+        if (isFireGenerated)
+        {
+            particleGenerator->setBackend(particleBackend);
+            particleBackend = particleGenerator->getBackend();
+        }
+        particleBackendKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE)
+    {
+        particleBackendKeyPressed = false;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -431,90 +894,53 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-// utility function for loading a 2D texture from file
-// ---------------------------------------------------
-unsigned int loadTexture(char const* path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
-
-void collision_detection(Ball& ball, Model& model) {
+void collision_detection(BallSystem& balls, size_t ball, Model& model) {
+    PROFILE_SCOPE("collision_detection");
     // ȡӵ壩İ뾶λ
-    float radius = ball.getRadius();
-    glm::vec3 ball_center = ball.getPosition();
+    float radius = balls.radius[ball];
+    glm::vec3 ball_center = balls.getPosition(ball);
     // std::cout << "ǰСλã " << ball_center.x << " " << ball_center.y << " " << ball_center.z << std::endl;
 
        if (model.isSphereBoundingBoxIntersectingAABB(ball_center, radius)) {
 
-        // ģеÿ(mesh)
-        for (Mesh& mesh : model.meshes) {
-            // ÿƬ
-            for (unsigned int i = 0; i < mesh.indices.size(); i += 3) {
-                // ȡƬĶ
-                glm::vec3 v1 = mesh.vertices[mesh.indices[i]].Position;
-                v1 = model.transformPoint(v1);
-                glm::vec3 v2 = mesh.vertices[mesh.indices[i + 1]].Position;
-                v2 = model.transformPoint(v2);
-                glm::vec3 v3 = mesh.vertices[mesh.indices[i + 2]].Position;
-                v3 = model.transformPoint(v3);
-                glm::vec3 mesh_normal = normalize(cross((v1 - v3), (v2 - v3)));
-                // glm::vec3 mesh_normal = normalize(mesh.vertices[mesh.indices[i]].Normal);
-                bool isReversed = dot(ball.getVelocity(), mesh_normal) < 0;
-                // std::cout << "ball_Center" << ball_center.x << " " << ball_center.y << " " << ball_center.z << std::endl;
-                // std::cout << "v1" << v1.x << " " << v1.y << " " << v1.z << std::endl;
-
-
-                if (isReversed && testSphereTriangle_test(ball_center, radius, v1, v2, v3, mesh_normal, ball)) {
-                    std::cout << "collison!!!" << std::endl;
-                    // ball.setActive(false);
-                    glm::vec3 ballVelocity = ball.getVelocity();
-                    glm::vec3 point = (v1 + v2 + v3) / 3.0f;
-                    glm::vec3 meshVelocity = model.getPointVelocity(point);
-                    // std::cout << "ԭٶȣ" << oldspeed.x << " " << oldspeed.y << " " << oldspeed.z << std::endl;
-                    reflectVec3_modified(ballVelocity, meshVelocity, mesh_normal);
-                    model.setAngularSpeed(meshVelocity, point, mesh_normal);
-                    ball.setVelocity(ballVelocity);
-                    ball.setTexture(model.getTexture());
-                    
-                    glm::vec3 pos = ball.getPosition();
-                    // std::cout << "ǰСλã " << pos.x << " " << pos.y << " " << pos.z << std::endl;
-                    
-                    // std::cout << "" << mesh_normal.x << " " << mesh_normal.y << " " << mesh_normal.z << std::endl;
-                    // std::cout << "ǰٶȣ " << newspeed.x << " " << newspeed.y << " " << newspeed.z << std::endl;
-                    return; // ײ˳
-                }
+        // only triangles near the ball: testSphereTriangle_test rejects every triangle with all
+        // vertices farther than 3 * radius, so the BVH is queried with that radius
+        static std::vector<uint32_t> candidates;
+        candidates.clear();
+        model.queryTriangles(ball_center, 3 * radius, candidates);
+        // keep the mesh order of the full walk, the first hit wins
+        std::sort(candidates.begin(), candidates.end());
+        for (uint32_t triangle : candidates) {
+            // ȡƬĶ
+            const TriangleBVH::Triangle& local = model.asset->bvh.triangle(triangle);
+            glm::vec3 v1 = model.transformPoint(local.v1);
+            glm::vec3 v2 = model.transformPoint(local.v2);
+            glm::vec3 v3 = model.transformPoint(local.v3);
+            glm::vec3 mesh_normal = normalize(cross((v1 - v3), (v2 - v3)));
+            // glm::vec3 mesh_normal = normalize(mesh.vertices[mesh.indices[i]].Normal);
+            bool isReversed = dot(balls.getVelocity(ball), mesh_normal) < 0;
+            // std::cout << "ball_Center" << ball_center.x << " " << ball_center.y << " " << ball_center.z << std::endl;
+            // std::cout << "v1" << v1.x << " " << v1.y << " " << v1.z << std::endl;
+
+
+            if (isReversed && testSphereTriangle_test(ball_center, radius, v1, v2, v3, mesh_normal)) {
+                std::cout << "collison!!!" << std::endl;
+                // ball.setActive(false);
+                glm::vec3 ballVelocity = balls.getVelocity(ball);
+                glm::vec3 point = (v1 + v2 + v3) / 3.0f;
+                glm::vec3 meshVelocity = model.getPointVelocity(point);
+                // std::cout << "ԭٶȣ" << oldspeed.x << " " << oldspeed.y << " " << oldspeed.z << std::endl;
+                reflectVec3_modified(ballVelocity, meshVelocity, mesh_normal);
+                model.setAngularSpeed(meshVelocity, point, mesh_normal);
+                balls.setVelocity(ball, ballVelocity);
+                balls.texture[ball] = model.getTexture();
+                
+                glm::vec3 pos = balls.getPosition(ball);
+                // std::cout << "ǰСλã " << pos.x << " " << pos.y << " " << pos.z << std::endl;
+                
+                // std::cout << "" << mesh_normal.x << " " << mesh_normal.y << " " << mesh_normal.z << std::endl;
+                // std::cout << "ǰٶȣ " << newspeed.x << " " << newspeed.y << " " << newspeed.z << std::endl;
+                return; // ײ˳
             }
         }
      }
@@ -532,7 +958,7 @@ bool testSphereTriangle(const glm::vec3& center, const glm::vec3& v1, const glm:
 }
 
 // ƬǷཻĺ
-bool testSphereTriangle_test(const glm::vec3& center, float radius, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3, const glm::vec3& mesh_normal, Ball &ball) {
+bool testSphereTriangle_test(const glm::vec3& center, float radius, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3, const glm::vec3& mesh_normal) {
     // std::cout << "v1: " << v1.x << " " << v1.y << " " << v1.z << std::endl;
     // ҪʵƬǷཻ
     if (glm::distance(center, v1) > 3 * radius && glm::distance(center, v2) > 3 * radius && glm::distance(center, v3) > 3 * radius) {
@@ -591,7 +1017,10 @@ void reflectVec3_modified(glm::vec3& A, glm::vec3& B, const glm::vec3& norm) {
 
 
 void generateRandomBalls(int numBalls) {
-    srand(static_cast<unsigned int>(time(nullptr))); // ʼ
+    srand(ballSeed != 0 ? ballSeed : static_cast<unsigned int>(time(nullptr))); // ʼ
+    // every ball starts with the same look, load it once
+    unsigned int startTexture = TextureCache::instance().load("./texture/ball_white.jpg");
+    balls.reserve(balls.size() + numBalls);
 
     for (int i = 0; i < numBalls; ++i) {
         // λúٶ
@@ -607,7 +1036,7 @@ void generateRandomBalls(int numBalls) {
             rand() / (float)RAND_MAX * 2 * speedLimit - speedLimit
         );
 
-        balls.emplace_back(position, velocity, ballRadius, "./texture/ball_white.jpg");
+        balls.add(position, velocity, ballRadius, startTexture);
     }
 
     return;
@@ -615,10 +1044,11 @@ void generateRandomBalls(int numBalls) {
 
 
 
-void collision_detection_wall(Ball& ball, Room &room) {
-    float radius = ball.getRadius();
-    glm::vec3 ball_center = ball.getPosition();
-    glm::vec3 ball_velocity = ball.getVelocity();
+void collision_detection_wall(BallSystem& balls, size_t ball, Room &room) {
+    PROFILE_SCOPE("collision_detection_wall");
+    float radius = balls.radius[ball];
+    glm::vec3 ball_center = balls.getPosition(ball);
+    glm::vec3 ball_velocity = balls.getVelocity(ball);
 
     float tolerance = 0.05f;
 
@@ -638,45 +1068,45 @@ void collision_detection_wall(Ball& ball, Room &room) {
         ball_velocity.x = -ball_velocity.x * e_wall; // 
         ball_velocity.y *= (1 - friction_wall); // Ħ
         ball_velocity.z *= (1 - friction_wall); // Ħ
-        ball.setVelocity(ball_velocity);
-        ball.setTexture(room.getTexture(2));
+        balls.setVelocity(ball, ball_velocity);
+        balls.texture[ball] = room.getTexture(2);
         return;
     }
     if (maxBox.x >= rightWall && ball_velocity.x > 0) {
         ball_velocity.x = -ball_velocity.x * e_wall; // 
         ball_velocity.y *= (1 - friction_wall); // Ħ
         ball_velocity.z *= (1 - friction_wall); // Ħ
-        ball.setVelocity(ball_velocity);
-        ball.setTexture(room.getTexture(3));
+        balls.setVelocity(ball, ball_velocity);
+        balls.texture[ball] = room.getTexture(3);
         return;
     }
     if (minBox.y <= floor && ball_velocity.y < 0) { // ذ컨
         ball_velocity.y = -ball_velocity.y * e_wall; // 
         ball_velocity.x *= (1 - friction_wall); // Ħ
         ball_velocity.z *= (1 - friction_wall); // Ħ
-        ball.setVelocity(ball_velocity);
-        ball.setTexture(room.getTexture(4));
+        balls.setVelocity(ball, ball_velocity);
+        balls.texture[ball] = room.getTexture(4);
         return;
     }
     if (maxBox.y >= ceiling && ball_velocity.y > 0) {
         ball_velocity.y = -ball_velocity.y * e_wall; // 
         ball_velocity.x *= (1 - friction_wall); // Ħ
         ball_velocity.z *= (1 - friction_wall); // Ħ
-        ball.setVelocity(ball_velocity);
-        ball.setTexture(room.getTexture(5));
+        balls.setVelocity(ball, ball_velocity);
+        balls.texture[ball] = room.getTexture(5);
         return;
     }
     if (minBox.z <= backWall && ball_velocity.z < 0) { // ǽ
         ball_velocity.z = -ball_velocity.z * e_wall; // 
         ball_velocity.x *= (1 - friction_wall); // Ħ
         ball_velocity.y *= (1 - friction_wall); // Ħ
-        ball.setVelocity(ball_velocity);
-        ball.setTexture(room.getTexture(0));
+        balls.setVelocity(ball, ball_velocity);
+        balls.texture[ball] = room.getTexture(0);
         return;
     }
 
     // ٶ
-    ball.setVelocity(ball_velocity);
+    balls.setVelocity(ball, ball_velocity);
 }
 
 glm::vec3 getViewPos(int x, int y, glm::mat4 pro, glm::mat4 view)
@@ -726,13 +1156,14 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 
 
 void dragModel() {
+    PROFILE_SCOPE("dragModel");
     // ȡӵ壩İ뾶λ
     for (int k = 0; k < tumblers.size(); k++) {
         // std::cout << " " << k << " " << std::endl;
     if (tumblers[k].isSphereBoundingBoxIntersectingAABB(newMousePoint, 0)) {
 
         // ģеÿ(mesh)
-        for (Mesh& mesh : tumblers[k].meshes) {
+        for (const Mesh& mesh : tumblers[k].asset->meshes) {
             // ÿƬ
             for (unsigned int i = 0; i < mesh.indices.size() - 3; i += 3) {
                 // ȡƬĶ
@@ -842,8 +1273,226 @@ void collision_detection_fire() {
 void generateFire() {
     if (!isFireGenerated) {
         particleGenerator = new ParticleGenerator("./texture/fire.jpg", particleCount);
+        particleGenerator->setBackend(particleBackend);
         // Initialize EmitterState with start position, velocity, and dampening
         emitterState = new EmitterState(glm::vec3(4.0f, 3.0f, 0.0f), glm::vec3(4.0f, 0.0f, 0.0f), 1.0f);
         isFireGenerated = true;
     }
-}
\ No newline at end of file
+}
+
+// advances the simulation by one fixed step: tumbler wobbling, ball physics and collisions, fire
+// ----------------------------------------------------------------------------------------------
+void simulationStep(float dt, Room& room, Flame::FlameManager* flames)
+{
+    PROFILE_SCOPE("simulationStep");
+    for (auto it = tumblers.begin(); it != tumblers.end(); ++it) {
+        it->updateWobbling(dt);
+    }
+
+    if (isBallsGenerated) {
+        balls.integrate(dt);
+        ballGrid.build(balls);
+        ballGrid.collide(balls, e, m_ball);
+        for (size_t i = 0; i < balls.size(); i++) {
+            if (balls.isActive(i)) {
+                collision_detection_wall(balls, i, room);
+                if (balls.posY[i] >= examBorder) continue;
+                for (auto it = tumblers.begin(); it != tumblers.end(); ++it) {
+                    collision_detection(balls, i, *it);
+                }
+            }
+        }
+    }
+
+    if (isFireGenerated) {
+        collision_detection_fire();
+        particleGenerator->Update(dt, *emitterState, particleCount, glm::vec3(0.0f));
+    }
+
+    if (flames)
+        flames->Update(dt);
+}
+
+// ball-ball collision cost for growing ball counts at a constant density (the radius shrinks
+// so the balls always fill the same share of the room). With a linear broad phase the time
+// per ball stays flat from 1k to 100k balls.
+// ------------------------------------------------------------------------------------------
+void benchmarkBallCollisions()
+{
+    const int counts[] = { 1000, 3000, 10000, 30000, 100000 };
+    const int steps = 100;
+    const float dt = 1.0f / 120.0f;
+    const float fillRatio = 0.2f;
+    const glm::vec3 halfRoom(roomWidth / 2.0f, roomHeight / 2.0f, roomDepth / 2.0f);
+    float roomVolume = (float)roomWidth * roomHeight * roomDepth;
+
+    std::cout << "balls,radius,cells,contacts_per_step,build_ms,collide_ms,ns_per_ball" << std::endl;
+    for (int count : counts) {
+        float radius = std::cbrt(fillRatio * roomVolume / count * 3.0f / (4.0f * PI));
+        BallSystem system;
+        BallGrid grid(roomWidth, roomHeight, roomDepth);
+        system.reserve(count);
+        srand(1);
+        for (int i = 0; i < count; ++i) {
+            glm::vec3 position(
+                (rand() / (float)RAND_MAX * 2.0f - 1.0f) * (halfRoom.x - radius),
+                (rand() / (float)RAND_MAX * 2.0f - 1.0f) * (halfRoom.y - radius),
+                (rand() / (float)RAND_MAX * 2.0f - 1.0f) * (halfRoom.z - radius));
+            glm::vec3 velocity(
+                rand() / (float)RAND_MAX * 2 * speedLimit - speedLimit,
+                rand() / (float)RAND_MAX * 2 * speedLimit - speedLimit,
+                rand() / (float)RAND_MAX * 2 * speedLimit - speedLimit);
+            system.add(position, velocity, radius, 0);
+        }
+
+        double buildMs = 0.0, collideMs = 0.0;
+        long long contacts = 0;
+        for (int s = 0; s < steps; ++s) {
+            system.integrate(dt);
+            // keep the balls inside the room, the wall response of the scene needs a Room
+            for (size_t i = 0; i < system.size(); ++i) {
+                float* position[3] = { &system.posX[i], &system.posY[i], &system.posZ[i] };
+                float* velocity[3] = { &system.velX[i], &system.velY[i], &system.velZ[i] };
+                for (int axis = 0; axis < 3; ++axis) {
+                    float limit = halfRoom[axis] - radius;
+                    if (std::fabs(*position[axis]) > limit) {
+                        *position[axis] = *position[axis] > 0.0f ? limit : -limit;
+                        *velocity[axis] = -*velocity[axis] * e_wall;
+                    }
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            grid.build(system);
+            auto built = std::chrono::steady_clock::now();
+            contacts += grid.collide(system, e, m_ball);
+            auto end = std::chrono::steady_clock::now();
+            buildMs += std::chrono::duration<double, std::milli>(built - start).count();
+            collideMs += std::chrono::duration<double, std::milli>(end - built).count();
+        }
+
+        buildMs /= steps;
+        collideMs /= steps;
+        std::cout << count << "," << radius << "," << grid.cellCount() << "," << contacts / steps << ","
+            << buildMs << "," << collideMs << "," << (buildMs + collideMs) * 1.0e6 / count << std::endl;
+    }
+}
+
+// CPU particle update for growing pools, on the calling thread and split across the worker
+// pool. Every step refills the pool, so the update always runs on a full store.
+// ------------------------------------------------------------------------------------------
+void benchmarkParticleUpdate()
+{
+    const int counts[] = { 10000, 30000, 100000, 300000, 1000000 };
+    const int steps = 100;
+    const float dt = 1.0f / 120.0f;
+
+    std::cout << "particles,threads,serial_ms,parallel_ms,ns_per_particle,speedup" << std::endl;
+    for (int count : counts) {
+        ParticleStore store(count);
+        srand(1);
+        double serialMs = 0.0, parallelMs = 0.0;
+        for (int s = 0; s < 2 * steps; ++s) {
+            while (store.size() < store.capacity()) {
+                Particle particle;
+                particle.Position = glm::vec3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+                particle.Velocity = glm::vec3(rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX - 0.5f);
+                particle.Life = 0.2f + rand() / (float)RAND_MAX;
+                store.add(particle);
+            }
+            // first half of the steps serial, second half parallel
+            bool parallel = s >= steps;
+            auto start = std::chrono::steady_clock::now();
+            store.update(dt, parallel);
+            auto end = std::chrono::steady_clock::now();
+            (parallel ? parallelMs : serialMs) += std::chrono::duration<double, std::milli>(end - start).count();
+        }
+
+        serialMs /= steps;
+        parallelMs /= steps;
+        std::cout << count << "," << WorkerPool::instance().threadCount() << "," << serialMs << "," << parallelMs << ","
+            << parallelMs * 1.0e6 / count << "," << serialMs / parallelMs << std::endl;
+    }
+}
+
+// flame cost per frame (update + draw) on the transform feedback and the compute backend,
+// from the default 1,800 particles up to 1M. Then the same for many flames of 1,800 particles
+// each: one Flame object per flame against a single FlameManager. GPU time comes from
+// GL_TIME_ELAPSED queries, CPU time is what rendering takes to submit the work.
+// ------------------------------------------------------------------------------------------
+void benchmarkFlame()
+{
+    const int counts[] = { 1800, 10000, 100000, 1000000 };
+    const int flameCounts[] = { 1, 8, 32 };
+    const int warmup = 30;
+    const int frames = 200;
+    const float dt = 1.0f / 60.0f;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.0f, 4.0f), glm::vec3(0.0f, 0.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    OffscreenTarget target;
+    target.create(SCR_WIDTH, SCR_HEIGHT);
+    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    // average GPU and CPU milliseconds per frame of render
+    auto measure = [&](const std::function<void()>& render, double& gpuMs, double& cpuMs) {
+        GpuProfiler profiler;
+        cpuMs = 0.0;
+        for (int i = 0; i < warmup + frames; ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, target.FBO);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            auto start = std::chrono::steady_clock::now();
+            profiler.beginPass("flame");
+            render();
+            profiler.endPass();
+            auto end = std::chrono::steady_clock::now();
+            profiler.endFrame();
+            if (i >= warmup)
+                cpuMs += std::chrono::duration<double, std::milli>(end - start).count();
+        }
+        // let the last queries finish so the average covers the end of the run
+        glFinish();
+        profiler.endFrame();
+        gpuMs = profiler.average("flame");
+        cpuMs /= frames;
+    };
+
+    double gpuMs = 0.0, cpuMs = 0.0;
+    std::cout << "particles,backend,gpu_ms,cpu_ms" << std::endl;
+    for (int count : counts) {
+        for (int b = 0; b < 2; ++b) {
+            Flame::FlameBackend backend = b == 0 ? Flame::FLAME_TRANSFORM_FEEDBACK : Flame::FLAME_COMPUTE;
+            if (backend == Flame::FLAME_COMPUTE && !Flame::FlameCompute::supported())
+                continue;
+            Flame::Flame flame(backend, count);
+            measure([&]() { flame.Render(dt, view, projection); }, gpuMs, cpuMs);
+            std::cout << count << "," << (b == 0 ? "transform_feedback" : "compute") << ","
+                << gpuMs << "," << cpuMs << std::endl;
+        }
+    }
+
+    if (Flame::FlameManager::supported()) {
+        std::cout << "flames,mode,gpu_ms,cpu_ms" << std::endl;
+        for (int flameCount : flameCounts) {
+            {
+                std::vector<std::unique_ptr<Flame::Flame>> separate;
+                for (int i = 0; i < flameCount; ++i)
+                    separate.emplace_back(new Flame::Flame(Flame::FLAME_COMPUTE));
+                measure([&]() {
+                    for (auto& flame : separate)
+                        flame->Render(dt, view, projection);
+                }, gpuMs, cpuMs);
+                std::cout << flameCount << ",separate," << gpuMs << "," << cpuMs << std::endl;
+            }
+            Flame::FlameManager manager;
+            for (int i = 0; i < flameCount; ++i)
+                manager.add(glm::vec3(0.1f * (i % 8) - 0.35f, 0.0f, -0.1f * (i / 8)));
+            measure([&]() {
+                manager.Update(dt);
+                manager.Render(view, projection);
+            }, gpuMs, cpuMs);
+            std::cout << flameCount << ",manager," << gpuMs << "," << cpuMs << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    target.destroy();
+}
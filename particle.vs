@@ -1,11 +1,11 @@
 #version 330 core
 layout (location = 0) in vec4 vertex; 
+layout (location = 1) in vec3 offset; // per instance
+layout (location = 2) in vec4 color;  // per instance
 out vec2 TexCoords;
 out vec4 ParticleColor;
 
 uniform mat4 projection;
-uniform vec3 offset;
-uniform vec4 color;
 uniform mat4 model;
 uniform mat4 view;
 
@@ -0,0 +1,61 @@
+#version 430 core
+// appends newly emitted particles to the live list of the current particle buffer
+layout(local_size_x = 64) in;
+
+struct Particle {
+    vec4 positionLife; // xyz position, w remaining life in seconds
+    vec4 velocity;
+    vec4 color;
+};
+
+layout(std430, binding = 0) writeonly buffer Particles { Particle particles[]; };
+// the draw command of the buffer: instanceCount is the live count, the word after the
+// command counts particles dropped because the buffer was full
+layout(binding = 0, offset = 4) uniform atomic_uint aliveCount;
+layout(binding = 0, offset = 16) uniform atomic_uint overflowCount;
+
+uniform uint emitCount;
+uniform uint limit; // live count this dispatch may fill up to, below capacity for fire
+uniform uint seed; // emission dispatch index
+uniform vec3 emitterPosition;
+uniform vec3 emitterVelocity;
+uniform vec3 offset;
+uniform bool sparks;
+uniform float sparkSign; // 1 pushes sparks along the random direction, -1 against it
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= emitCount)
+        return;
+    uint rng = rngInit(id, seed, 0u);
+
+    Particle p;
+    if (sparks) {
+        // same ranges as ParticleGenerator::createSparks
+        vec3 randomDir = (vec3(rngNext(rng), rngNext(rng), rngNext(rng)) - 2.0) * 3.0;
+        p.velocity = vec4(emitterVelocity * 0.2 + sparkSign * randomDir, 0.0);
+        float life = 0.7 + 0.2 * rngNext(rng);
+        float brightness = 0.5 + 0.5 * rngNext(rng);
+        p.color = vec4(vec3(brightness), 1.0);
+        p.positionLife = vec4(emitterPosition + offset, life);
+    }
+    else {
+        // same ranges as ParticleGenerator::respawnParticle
+        vec3 random1 = vec3(rngNext(rng) * 0.5 - 1.0, rngNext(rng) - 2.0, rngNext(rng) * 0.5 - 1.0);
+        float rColor = 0.5 + 0.5 * rngNext(rng);
+        vec3 random2 = vec3(rngNext(rng) * 0.5 - 1.0, rngNext(rng) - 2.0, rngNext(rng) * 0.5 - 1.0);
+        p.positionLife = vec4(emitterPosition + random1, 0.2);
+        p.color = vec4(vec3(rColor), 1.0);
+        p.velocity = vec4(emitterVelocity + random2 / 3.0, 0.0);
+    }
+
+    uint index = atomicCounterIncrement(aliveCount);
+    if (index >= limit) {
+        // full: undo the increment, the live count ends at limit
+        atomicCounterDecrement(aliveCount);
+        atomicCounterIncrement(overflowCount);
+        return;
+    }
+    particles[index] = p;
+}
@@ -0,0 +1,38 @@
+#version 430 core
+// ages and moves the live particles of the source buffer; survivors are appended to the
+// destination buffer, so the live particles stay packed without any sorting
+layout(local_size_x = 256) in;
+
+struct Particle {
+    vec4 positionLife; // xyz position, w remaining life in seconds
+    vec4 velocity;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Source { Particle source[]; };
+layout(std430, binding = 1) writeonly buffer Destination { Particle destination[]; };
+// draw command of the source buffer, instanceCount is its live count
+layout(std430, binding = 2) readonly buffer SourceCommand {
+    uint vertexCount;
+    uint aliveCount;
+    uint first;
+    uint baseInstance;
+} sourceCommand;
+layout(binding = 0, offset = 4) uniform atomic_uint destinationAlive;
+
+uniform float deltaTime;
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= sourceCommand.aliveCount)
+        return;
+
+    Particle p = source[id];
+    p.positionLife.w -= deltaTime; // reduce life
+    if (p.positionLife.w <= 0.0)
+        return;
+    p.positionLife.xyz -= p.velocity.xyz * deltaTime;
+    p.color.a -= deltaTime * 2.5;
+    destination[atomicCounterIncrement(destinationAlive)] = p;
+}
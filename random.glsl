@@ -0,0 +1,26 @@
+// Stateless random numbers for the particle shaders. Inserted after the #version line of
+// every shader that uses it (Shader::readFile passed as defines), so all of them draw the
+// same sequences from the same seeds.
+
+// PCG hash: one well mixed 32-bit value per input
+uint pcgHash(uint v)
+{
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// state for the numbers one particle draws in one frame: id is the particle, frame the
+// frame or dispatch index and seed the run (or the pass, when two passes draw for the
+// same particle in the same frame)
+uint rngInit(uint id, uint frame, uint seed)
+{
+    return pcgHash(id ^ pcgHash(frame ^ pcgHash(seed)));
+}
+
+// uniform in [0, 1), advances the state
+float rngNext(inout uint state)
+{
+    state = pcgHash(state);
+    return float(state >> 8u) / 16777216.0;
+}